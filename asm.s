@@ -32,3 +32,35 @@ fracumul:
   mov r0, r2
   bx lr
 
+
+@ void irq_call_nested(void (*fn)(void))
+@ Call from isr() after acknowledging its interrupts.  Runs fn in
+@ System mode on the user stack with IRQs enabled, so a long handler
+@ neither overflows the 160-byte IRQ stack nor holds off vblank.
+@ spsr_irq and lr_irq go on the IRQ stack and the interrupted code's
+@ lr goes on the user stack, because a nested IRQ overwrites the
+@ first two and fn overwrites the third.  fn must cope with isr()
+@ running again underneath it.
+
+.ARM
+.ALIGN
+.GLOBL  irq_call_nested
+
+irq_call_nested:
+  mrs   r3, spsr
+  stmfd sp!, {r3, lr}
+  mrs   r3, cpsr
+  bic   r3, r3, #0xDF
+  orr   r3, r3, #0x1F         @ System mode, IRQs on
+  msr   cpsr_c, r3
+  stmfd sp!, {r3, lr}
+  mov   lr, pc
+  bx    r0
+  ldmfd sp!, {r3, lr}
+  mrs   r3, cpsr
+  bic   r3, r3, #0xDF
+  orr   r3, r3, #0x92         @ IRQ mode, IRQs off
+  msr   cpsr_c, r3
+  ldmfd sp!, {r3, lr}
+  msr   spsr, r3
+  bx    lr
@@ -34,6 +34,9 @@
 //efine	HAS_UTIMBUF	1		/* struct utimbuf		*/
 //efine	HAS_UTIMEUSEC   1		/* microseconds in utimbuf?	*/
 
+/* pin8gba.h has the same, and a profiling build includes it first */
+#ifndef CODE_IN_IWRAM
 #define CODE_IN_IWRAM __attribute__ ((section (".iwram"), long_call))
+#endif
 
 #endif	/* CONFIG_H */
@@ -52,9 +52,21 @@ typedef struct GBFS_FILE
   u32  total_len;    /* total length of archive */
   u16  dir_off;      /* offset in bytes to directory */
   u16  dir_nmemb;    /* number of files */
-  char reserved[8];  /* for future use */
+  u32  hash_off;     /* offset in bytes to name index, or 0 if none */
+  u16  hash_nmemb;   /* number of slots in name index */
+  char reserved[2];  /* for future use */
 } GBFS_FILE;
 
+/* The name index, written by gbfs -i, is an open addressing hash
+   table of hash_nmemb u16 slots, a power of 2 at least twice
+   dir_nmemb.  A slot holds 1 + the directory position of a name, or
+   0 if empty.  A name goes in the first free slot at or after
+   GBFS_HASH(name) & (hash_nmemb - 1), wrapping around.  The hash is
+   32-bit FNV-1a over the name's bytes up to its first nul or 24
+   bytes, whichever is first. */
+#define GBFS_FNV_BASIS 2166136261U
+#define GBFS_FNV_PRIME 16777619U
+
 typedef struct GBFS_ENTRY
 {
   char name[24];     /* filename, nul-padded */
@@ -64,6 +76,7 @@ typedef struct GBFS_ENTRY
 
 
 const GBFS_FILE *find_first_gbfs_file(const void *start);
+const GBFS_FILE *find_header_gbfs_file(void);
 const void *skip_gbfs_file(const GBFS_FILE *file);
 const void *gbfs_get_obj(const GBFS_FILE *file,
                          const char *name,
@@ -48,7 +48,6 @@ typedef gsm_byte 		gsm_frame[33];		/* 33 * 8 bits	 */
 #define	GSM_MAJOR		1
 
 #define	GSM_OPT_VERBOSE		1
-#define	GSM_OPT_FAST		2
 #define	GSM_OPT_LTP_CUT		3
 #define	GSM_OPT_WAV49		4
 #define	GSM_OPT_FRAME_INDEX	5
@@ -59,7 +58,15 @@ extern gsm  gsm_create 	GSM_P((void));
 extern void gsm_destroy GSM_P((gsm));	
 #endif
 
-__attribute__((long_call)) int  gsm_decode  GSM_P((gsm, gsm_byte   *, gsm_signal *));
+__attribute__((long_call)) int  gsm_decode  GSM_P((gsm, const gsm_byte *, gsm_signal *));
+__attribute__((long_call)) int  gsm_decode_raw  GSM_P((gsm, const gsm_byte *, gsm_signal *));
+__attribute__((long_call)) void gsm_postprocess_s8  GSM_P((gsm, const gsm_signal *, int, signed char *));
+__attribute__((long_call)) int  gsm_decode_n  GSM_P((gsm, const gsm_byte *, int, gsm_signal *));
+__attribute__((long_call)) int  gsm_decode_raw_n  GSM_P((gsm, const gsm_byte *, int, gsm_signal *));
+
+struct gsm_snapshot;
+__attribute__((long_call)) void gsm_snapshot_save  GSM_P((gsm, struct gsm_snapshot *));
+__attribute__((long_call)) void gsm_snapshot_load  GSM_P((gsm, const struct gsm_snapshot *));
 
 #undef	GSM_P
 
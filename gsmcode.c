@@ -15,18 +15,38 @@
 /* #include <string.h> */
 #define assert(x) ((void)0)
 
+/* GCC's >> on a negative int is an arithmetic shift, on the ARM and
+   on the PC alike, so private.h needn't emulate one in SASR(). */
+#define SASR
+
+/* Saturating adds that range analysis shows can't overflow for any
+   LARc are plain adds; see the comments at each use.  The output
+   doesn't change, which tools/gsmtest.c checks with 'coef'. */
+#define GSM_ADD_NOSAT(a, b)	(ltmp = (longword)(a) + (longword)(b))
+
+/* Define GSM_FAST to build a decoder that is allowed to differ from
+   the reference in ways an 8-bit DAC can't reproduce.  Measure it
+   against the exact decoder on your own songs with tools/gsmdec.c
+   and tools/pcmsnr.c before you ship it.  It is a build option only;
+   there is no run-time switch.
+
+   POSTPROC_MASK: Postprocessing() no longer clears the low 3 bits.
+   They never reach the >> 8, only the 2:1 midpoint's rounding.  This
+   saves one BIC per decoded sample, 160 cycles a frame or about 0.1%
+   of the CPU; PROF_POST is where it shows. */
+#ifdef GSM_FAST
+#define POSTPROC_MASK		(~0)
+#else
+#define POSTPROC_MASK		(~7)
+#endif
+
 
 #include "private.h"
 #include "gsm.h"
 #include "proto.h"
+#include "profile.h"
 #include "config.h"
 
-#if 0  /* turn this ON to enable color profiling */
-#define PROFILE_COLOR(r,g,b) (*(volatile unsigned short *)0x05000000 = (r) | (g) << 5 | (b) << 10)
-#else
-#define PROFILE_COLOR(r,g,b) ((void)0)
-#endif
-
 
 /* begin add.h ********************/
 
@@ -41,6 +61,7 @@ word gsm_sub P2((a,b), word a, word b)
 }
 #endif
 
+#if 0  /* folded into tools/apcmtab.c */
 static word gsm_asr P2((a,n), word a, int n)
 {
   if (n >= 16) return -(a < 0);
@@ -62,6 +83,7 @@ static word gsm_asl P2((a,n), word a, int n)
   if (n < 0) return gsm_asr(a, -n);
   return a << n;
 }
+#endif
 
 /* begin long_term.c ********************/
 
@@ -75,7 +97,17 @@ static word gsm_asl P2((a,n), word a, int n)
 /* 4.3.2 */
 
 /* GSM_LTSF() is the second biggest bottleneck next to GSM_STSF().
-   Some unrolling here helped quite a bit.
+
+   The drp history used to be shifted down by 120 words after every
+   subframe.  Now S->dp0 is a ring of GSM_DRP_RING = 160 words, one
+   whole frame, and subframe j always writes dp0[40*j .. 40*j+39].
+   A lag that reaches back past dp0[0] lands on the previous frame's
+   samples at the end of the ring, so nothing ever has to move.
+
+   The shift was 480 halfword loads and 480 stores per frame.  From
+   IWRAM that is 3 + 2 cycles a word plus the loop, about 2,900
+   cycles per frame.  Splitting the loop at the wrap costs about 20.
+   Check it with PROF_LTP in a PROFILE = 1 build.
 */
 static void Gsm_Long_Term_Synthesis_Filtering P5((S,Ncr,bcr,erp,drp),
 					  struct gsm_state	* S,
@@ -83,7 +115,7 @@ static void Gsm_Long_Term_Synthesis_Filtering P5((S,Ncr,bcr,erp,drp),
 					  word			Ncr,
 					  word			bcr,
 					   word		* erp,	   /* [0..39]		  	 IN */
-					   word		* drp	   /* [-120..-1] IN, [-120..40] OUT */
+					   word		* drp	   /* [0..39] OUT, inside S->dp0 */
 					  )
      /*
       *  This procedure uses the bcr and Ncr parameter to realize the
@@ -91,7 +123,8 @@ static void Gsm_Long_Term_Synthesis_Filtering P5((S,Ncr,bcr,erp,drp),
       *  table 4.3b.
       */
 {
-  int k, brp, drpp, Nr;
+  int k, brp, drpp, Nr, wrap;
+  word *hist;
 
   /*  Check the limits of Nr.
    */
@@ -108,32 +141,27 @@ static void Gsm_Long_Term_Synthesis_Filtering P5((S,Ncr,bcr,erp,drp),
    */
   assert(brp != MIN_WORD);
 
-  for (k = 0; k <= 39; ) {
+  /*  drp[k - Nr] for k < wrap comes from before dp0[0], that is,
+   *  from the end of the ring.
+   */
+  wrap = Nr - (drp - S->dp0);
+  if (wrap > 40)
+    wrap = 40;
+
 #undef LTSF_STEP
 #define LTSF_STEP \
-    drpp   = GSM_MULT_R( brp, drp[ k - Nr ] ); \
+    drpp   = GSM_MULT_R( brp, hist[ k ] ); \
     drp[k] = erp[k] + drpp; \
     k++;
 
-    LTSF_STEP
-    LTSF_STEP
-    LTSF_STEP
-    LTSF_STEP
+  k = 0;
+  hist = drp - Nr + GSM_DRP_RING;
+  while (k < wrap) {
     LTSF_STEP
   }
-
-  /*
-   *  Update of the reconstructed short term residual signal
-   *  drp[ -1..-120 ]
-   */
-
-  for (k = 0; k <= 119; k += 5)
-  {
-    drp[ -120 + k ] = drp[ -80 + k ];
-    drp[ -119 + k ] = drp[ -79 + k ];
-    drp[ -118 + k ] = drp[ -78 + k ];
-    drp[ -117 + k ] = drp[ -77 + k ];
-    drp[ -116 + k ] = drp[ -76 + k ];
+  hist = drp - Nr;
+  while (k <= 39) {
+    LTSF_STEP
   }
 }
 
@@ -146,13 +174,16 @@ static void Gsm_Long_Term_Synthesis_Filtering P5((S,Ncr,bcr,erp,drp),
 
 /* 4.2.8 */
 
+/* LARc[0..7] are only 6, 6, 5, 5, 4, 4, 3, and 3 bits wide, so
+   tools/lartab.c runs the arithmetic below for every code value
+   ahead of time.  See lartab.h. */
+
+#include "lartab.h"
+
 static void Decoding_of_the_coded_Log_Area_Ratios P2((LARc,LARpp),
 						     word 	* LARc,		/* coded log area ratio	[0..7] 	IN	*/
 						     word	* LARpp)	/* out: decoded ..			*/
 {
-  register word	temp1 /* , temp2 */;
-  register long	ltmp;	/* for GSM_ADD */
-
   /*  This procedure requires for efficient implementation
    *  two tables.
    *
@@ -177,21 +208,18 @@ static void Decoding_of_the_coded_Log_Area_Ratios P2((LARc,LARpp),
    */
 
 #undef	STEP
-#define	STEP( B, MIC, INVA )	\
-		temp1    = GSM_ADD( *LARc++, MIC ) << 10;	\
-		temp1    = GSM_SUB( temp1, B << 1 );		\
-		temp1    = GSM_MULT_R( INVA, temp1 );		\
-		*LARpp++ = GSM_ADD( temp1, temp1 );
-
-  STEP(      0,  -32,  13107 );
-  STEP(      0,  -32,  13107 );
-  STEP(   2048,  -16,  13107 );
-  STEP(  -2560,  -16,  13107 );
-
-  STEP(     94,   -8,  19223 );
-  STEP(  -1792,   -8,  17476 );
-  STEP(   -341,   -4,  31454 );
-  STEP(  -1144,   -4,  29708 );
+#define	STEP( i )	\
+		LARpp[i] = gsm_LARpp_tab[ gsm_LARc_base[i] + LARc[i] ];
+
+  STEP( 0 );
+  STEP( 1 );
+  STEP( 2 );
+  STEP( 3 );
+
+  STEP( 4 );
+  STEP( 5 );
+  STEP( 6 );
+  STEP( 7 );
 
   /* NOTE: the addition of *MIC is used to restore
    * 	 the sign of *LARc.
@@ -214,6 +242,11 @@ static void Decoding_of_the_coded_Log_Area_Ratios P2((LARc,LARpp),
  * (Initial value: LARpp(j-1)[1..8] = 0.)
  */
 
+/*  LARpp is within [-26214, 25394] (see lartab.h), so none of these
+ *  sums can leave word range.  In fact, for any word inputs, the
+ *  shifted sums below stay within [-32768, 32766].
+ */
+
 static void Coefficients_0_12 P3((LARpp_j_1, LARpp_j, LARp),
 				  word * LARpp_j_1,
 				  word * LARpp_j,
@@ -223,8 +256,8 @@ static void Coefficients_0_12 P3((LARpp_j_1, LARpp_j, LARp),
    longword ltmp;
 
   for (i = 1; i <= 8; i++, LARp++, LARpp_j_1++, LARpp_j++) {
-    *LARp = GSM_ADD( SASR( *LARpp_j_1, 2 ), SASR( *LARpp_j, 2 ));
-    *LARp = GSM_ADD( *LARp,  SASR( *LARpp_j_1, 1));
+    *LARp = GSM_ADD_NOSAT( SASR( *LARpp_j_1, 2 ), SASR( *LARpp_j, 2 ));
+    *LARp = GSM_ADD_NOSAT( *LARp,  SASR( *LARpp_j_1, 1));
   }
 }
 
@@ -236,7 +269,7 @@ static void Coefficients_13_26 P3((LARpp_j_1, LARpp_j, LARp),
    int i;
    longword ltmp;
   for (i = 1; i <= 8; i++, LARpp_j_1++, LARpp_j++, LARp++) {
-    *LARp = GSM_ADD( SASR( *LARpp_j_1, 1), SASR( *LARpp_j, 1 ));
+    *LARp = GSM_ADD_NOSAT( SASR( *LARpp_j_1, 1), SASR( *LARpp_j, 1 ));
   }
 }
 
@@ -249,22 +282,12 @@ static void Coefficients_27_39 P3((LARpp_j_1, LARpp_j, LARp),
    longword ltmp;
 
   for (i = 1; i <= 8; i++, LARpp_j_1++, LARpp_j++, LARp++) {
-    *LARp = GSM_ADD( SASR( *LARpp_j_1, 2 ), SASR( *LARpp_j, 2 ));
-    *LARp = GSM_ADD( *LARp, SASR( *LARpp_j, 1 ));
+    *LARp = GSM_ADD_NOSAT( SASR( *LARpp_j_1, 2 ), SASR( *LARpp_j, 2 ));
+    *LARp = GSM_ADD_NOSAT( *LARp, SASR( *LARpp_j, 1 ));
   }
 }
 
 
-static void Coefficients_40_159 P2((LARpp_j, LARp),
-				    word * LARpp_j,
-				    word * LARp)
-{
-   int i;
-
-  for (i = 1; i <= 8; i++, LARp++, LARpp_j++)
-    *LARp = *LARpp_j;
-}
-
 /* 4.2.9.2 */
 
 static void LARp_to_rp P1((LARp),
@@ -288,22 +311,38 @@ static void LARp_to_rp P1((LARp),
      * else temp = GSM_ADD( temp >> 2, 26112 );
      *
      * *LARp = *LARp < 0 ? -temp : temp;
+     *
+     * |LARp| <= 26214, so LARp is never MIN_WORD and
+     * (temp >> 2) + 26112 <= 32665 never saturates.
      */
 
     if (*LARp < 0) {
       temp = *LARp == MIN_WORD ? MAX_WORD : -(*LARp);
       *LARp = - ((temp < 11059) ? temp << 1
 		 : ((temp < 20070) ? temp + 11059
-		    :  GSM_ADD( temp >> 2, 26112 )));
+		    :  GSM_ADD_NOSAT( temp >> 2, 26112 )));
     } else {
       temp  = *LARp;
       *LARp =    (temp < 11059) ? temp << 1
 	: ((temp < 20070) ? temp + 11059
-	   :  GSM_ADD( temp >> 2, 26112 ));
+	   :  GSM_ADD_NOSAT( temp >> 2, 26112 ));
     }
   }
 }
 
+/* Samples 40..159 use LARp = LARpp(j) unchanged, so their reflection
+   coefficients come straight from LARc through lartab.h. */
+
+static void LARc_to_rp P2((LARc, rp),
+			  word * LARc,	/* [0..7] IN	*/
+			  word * rp)	/* [0..7] OUT	*/
+{
+  int i;
+
+  for (i = 0; i <= 7; i++)
+    rp[i] = gsm_rp_tab[ gsm_LARc_base[i] + LARc[i] ];
+}
+
 
 
 /* DY writes:
@@ -313,6 +352,25 @@ static void LARp_to_rp P1((LARp),
    release of the decoder.  Now on to the other bottleneck:
    Gsm_Long_Term_Synthesis_Filtering */
 
+#ifdef GSM_STSF_ASM
+
+/* stsf.s keeps the whole lattice in registers. */
+void gsm_stsf_arm(word *v, const word *rrp, int k,
+                  const word *wt, word *sr);
+
+static void Short_term_synthesis_filtering P5((S,rrp,k,wt,sr),
+					      struct gsm_state * S,
+					       word	* rrp,	/* [0..7]	IN	*/
+					       int	k,	/* k_end - k_start	*/
+					       word	* wt,	/* [0..k-1]	IN	*/
+					       word	* sr	/* [0..k-1]	OUT	*/
+					      )
+{
+  gsm_stsf_arm(S->v, rrp, k, wt, sr);
+}
+
+#else
+
 static void Short_term_synthesis_filtering P5((S,rrp,k,wt,sr),
 					      struct gsm_state * S,
 					       word	* rrp,	/* [0..7]	IN	*/
@@ -323,7 +381,6 @@ static void Short_term_synthesis_filtering P5((S,rrp,k,wt,sr),
 {
   word *v = S->v;
 
-  PROFILE_COLOR(31, 31, 0);
   while (k--) {
     int sri = *wt++;
     int rrp_i, v_i;
@@ -349,9 +406,10 @@ static void Short_term_synthesis_filtering P5((S,rrp,k,wt,sr),
 
     *sr++ = v[0] = sri;
   }
-  PROFILE_COLOR(0, 0, 31);
 }
 
+#endif /* GSM_STSF_ASM */
+
 
 static void Gsm_Short_Term_Synthesis_Filter P4((S, LARcr, wt, s),
 					struct gsm_state * S,
@@ -370,9 +428,7 @@ static void Gsm_Short_Term_Synthesis_Filter P4((S, LARcr, wt, s),
 #undef	FILTER
 #	define	FILTER	Short_term_synthesis_filtering
 
-  PROFILE_COLOR(31, 0, 15);
   Decoding_of_the_coded_Log_Area_Ratios( LARcr, LARpp_j );
-  PROFILE_COLOR(0, 0, 31);
 
   Coefficients_0_12( LARpp_j_1, LARpp_j, LARp );
   LARp_to_rp( LARp );
@@ -386,149 +442,22 @@ static void Gsm_Short_Term_Synthesis_Filter P4((S, LARcr, wt, s),
   LARp_to_rp( LARp );
   FILTER( S, LARp, 13, wt + 27, s + 27 );
 
-  Coefficients_40_159( LARpp_j, LARp );
-  LARp_to_rp( LARp );
+  LARc_to_rp( LARcr, LARp );
   FILTER(S, LARp, 120, wt + 40, s + 40);
 }
 
 
 /* begin lpc.c ********************/
 
-/* 4.12.15 */
-
-static void APCM_quantization_xmaxc_to_exp_mant P3((xmaxc,exp_out,mant_out),
-						   word		xmaxc,		/* IN 	*/
-						   word		* exp_out,	/* OUT	*/
-						   word		* mant_out )	/* OUT  */
-{
-  word	exp, mant;
-
-  /* Compute exponent and mantissa of the decoded version of xmaxc
-   */
-
-  exp = 0;
-  if (xmaxc > 15) exp = SASR(xmaxc, 3) - 1;
-  mant = xmaxc - (exp << 3);
-
-  if (mant == 0) {
-    exp  = -4;
-    mant = 7;
-  }
-  else {
-    while (mant <= 7) {
-      mant = mant << 1 | 1;
-      exp--;
-    }
-    mant -= 8;
-  }
-
-  assert( exp  >= -4 && exp <= 6 );
-  assert( mant >= 0 && mant <= 7 );
-
-  *exp_out  = exp;
-  *mant_out = mant;
-}
-
-
-/* 4.2.16 */
-
-static void APCM_inverse_quantization P4((xMc,mant,exp,xMp),
-					 register word	* xMc,	/* [0..12]			IN 	*/
-					 word		mant,
-					 word		exp,
-					 register word	* xMp)	/* [0..12]			OUT 	*/
-     /* 
-      *  This part is for decoding the RPE sequence of coded xMc[0..12]
-      *  samples to obtain the xMp[0..12] array.  Table 4.6 is used to get
-      *  the mantissa of xmaxc (FAC[0..7]).
-      */
-{
-  int	i;
-  word	temp, temp1, temp2, temp3;
-  longword	ltmp;
-
-  assert( mant >= 0 && mant <= 7 ); 
-
-  temp1 = gsm_FAC[ mant ];	/* see 4.2-15 for mant */
-  temp2 = GSM_SUB( 6, exp );	/* see 4.2-15 for exp  */
-  temp3 = gsm_asl( 1, GSM_SUB( temp2, 1 ));
-
-  for (i = 13; i--;) {
-
-    assert( *xMc <= 7 && *xMc >= 0 ); 	/* 3 bit unsigned */
-
-    /* temp = gsm_sub( *xMc++ << 1, 7 ); */
-    temp = (*xMc++ << 1) - 7;	        /* restore sign   */
-    assert( temp <= 7 && temp >= -7 ); 	/* 4 bit signed   */
-
-    temp <<= 12;				/* 16 bit signed  */
-    temp = GSM_MULT_R( temp1, temp );
-    temp = GSM_ADD( temp, temp3 );
-    /* *xMp++ = gsm_asr( temp, temp2 ); */
-    *xMp++ = temp >> temp2;
-  }
-}
-
-/* 4.2.17 */
-
-static void RPE_grid_positioning P3((Mc,xMp,ep),
-				    word		Mc,		/* grid position	IN	*/
-				    register word	* xMp,		/* [0..12]		IN	*/
-				    register word	* ep		/* [0..39]		OUT	*/
-				    )
-     /*
-      *  This procedure computes the reconstructed long term residual signal
-      *  ep[0..39] for the LTP analysis filter.  The inputs are the Mc
-      *  which is the grid position selection and the xMp[0..12] decoded
-      *  RPE samples which are upsampled by a factor of 3 by inserting zero
-      *  values.
-      */
-{
-  int	i;
-
-  assert(0 <= Mc && Mc <= 3);
-
-  /* FIXME: Get rid of this Duff's device */
-
-#if 0  /* turn on 1 if you're on a machine where Duff's device is fast */
-  i = 13;
-  switch (Mc) {
-  case 3: *ep++ = 0;
-  case 2:  do {
-    *ep++ = 0;
-  case 1:         *ep++ = 0;
-  case 0:         *ep++ = *xMp++;
-  } while (--i);
-  }
-#else
-  switch (Mc) {
-  case 3: *ep++ = 0;
-  case 2: *ep++ = 0;
-  case 1: *ep++ = 0;
-  case 0: *ep++ = *xMp++;
-  }
-  i = 12;
-  do {
-    *ep++ = 0;
-    *ep++ = 0;
-    *ep++ = *xMp++;
-  } while (--i);
-
-#endif
-  while (++Mc < 4) *ep++ = 0;
-
-  /*
-
-  int i, k;
-  for (k = 0; k <= 39; k++) ep[k] = 0;
-  for (i = 0; i <= 12; i++) {
-  ep[ Mc + (3*i) ] = xMp[i];
-  }
-  */
-}
+/* 4.12.15 .. 4.2.17 */
 
-/* 4.2.18 */
+/* A decoded RPE sample depends only on the 6-bit xmaxc and the 3-bit
+   xMc, so tools/apcmtab.c runs APCM_quantization_xmaxc_to_exp_mant()
+   and APCM_inverse_quantization() for all 64 * 8 of them ahead of
+   time.  What's left is RPE_grid_positioning(), which now looks up
+   each sample as it goes, so erp[] is written in one pass. */
 
+#include "apcmtab.h"
 
 static void Gsm_RPE_Decoding P5((S, xmaxcr, Mcr, xMcr, erp),
 			 struct gsm_state	* S,
@@ -538,14 +467,30 @@ static void Gsm_RPE_Decoding P5((S, xmaxcr, Mcr, xMcr, erp),
 			 word		* xMcr,  /* [0..12], 3 bits 		IN	*/
 			 word		* erp	 /* [0..39]			OUT 	*/
 			 )
+     /*
+      *  The xMp[0..12] decoded RPE samples are upsampled by a factor
+      *  of 3 by inserting zero values; Mcr is the grid position.
+      */
 {
-  word	exp, mant;
-  word	xMp[ 13 ];
+  const word *xMp = gsm_xMp_tab[ xmaxcr ];
+  int i;
+
+  assert(0 <= Mcr && Mcr <= 3);
 
-  APCM_quantization_xmaxc_to_exp_mant( xmaxcr, &exp, &mant );
-  APCM_inverse_quantization( xMcr, mant, exp, xMp );
-  RPE_grid_positioning( Mcr, xMp, erp );
+  switch (Mcr) {
+  case 3: *erp++ = 0;
+  case 2: *erp++ = 0;
+  case 1: *erp++ = 0;
+  case 0: *erp++ = xMp[ *xMcr++ ];
+  }
+  i = 12;
+  do {
+    *erp++ = 0;
+    *erp++ = 0;
+    *erp++ = xMp[ *xMcr++ ];
+  } while (--i);
 
+  while (++Mcr < 4) *erp++ = 0;
 }
 
 /* begin decode.c ********************/
@@ -567,48 +512,213 @@ static void Postprocessing P2((S,s),
   for (k = 160; k--; s++) {
     tmp = GSM_MULT_R( msr, 28180 );
     msr = GSM_ADD(*s, tmp);  	   /* Deemphasis 	     */
-    *s  = GSM_ADD(msr, msr) & 0xFFF8;  /* Truncation & Upscaling */
+    *s  = GSM_ADD(msr, msr) & POSTPROC_MASK;  /* Truncation & Upscaling */
   }
   S->msr = msr;
-  PROFILE_COLOR(29,31,27);
 }
 
-static void Gsm_Decoder P8((S,LARcr, Ncr,bcr,Mcr,xmaxcr,xMcr,s),
-		    struct gsm_state	* S,
+/* The player used to read Postprocessing()'s output back out of
+   memory just to upsample it 2:1 and narrow it to 8 bits for the
+   DMA buffer.  This does the de-emphasis, the upsampling, and the
+   narrowing in one pass and writes 2 * n bytes to dst.
+   The & 0xFFF8 looks useless for 8-bit output, but the midpoint
+   sample sums two of them, so it stays to keep the bytes the same.
+
+   GSM_UPSAMPLE_TAPS picks how the midpoint between two decoded
+   samples gets made.  Cycle counts are per output byte on the ARM7
+   running from IWRAM, estimated from the instruction sequence, and
+   include the de-emphasis that all three share (about 12).
+
+   2  linear, (a + b) / 2, about 15 cycles.  The original player.
+   4  4-point Hermite (Catmull-Rom) at t = 1/2, which works out to
+      (9 * (b + c) - (a + d)) / 16 with no multiplies, about 20
+      cycles.  Output runs 1 sample late.
+   8  8-tap polyphase FIR: the even phase passes samples through and
+      the odd phase is a Lanczos-4 windowed sinc, folded to 4
+      multiplies.  About 28 cycles, as the 7 taps of history don't
+      all fit in registers.  Output runs 3 samples late.
+
+   At 36314 output bytes per second that is about 3, 4, and 6
+   percent of the CPU, next to roughly 40 for the decoder itself.
+   How far the image at fs - f sits below a tone at f, where fs is
+   the 18157 Hz the player feeds the decoder at:
+
+              fs/8    fs/4    3fs/8
+     2        28 dB   16 dB    7 dB
+     4        48 dB   24 dB   11 dB
+     8        50 dB   43 dB   26 dB
+
+   S->ups_last always holds the last full sample written, so a pause
+   can hold it. */
+
+#ifndef GSM_UPSAMPLE_TAPS
+#define GSM_UPSAMPLE_TAPS 2
+#endif
 
-		    word		* LARcr,	/* [0..7]		IN	*/
+/* de-emphasis, truncation, and upscaling of the next input sample */
+#define POSTPROC_NEXT(cur) \
+    tmp = GSM_MULT_R( msr, 28180 ); \
+    msr = GSM_ADD(*s++, tmp);  	   /* Deemphasis 	     */ \
+    cur = GSM_ADD(msr, msr) & POSTPROC_MASK  /* Truncation & Upscaling */
+
+#define UPS_CLAMP_S8(x) ((x) > 127 ? 127 : (x) < -128 ? -128 : (x))
+
+/* Narrowing to 8 bits.  UPS_PUT() takes a sample that fits in 16
+   bits and UPS_PUT_WIDE() one that may overshoot.
+
+   GSM_DITHER 0 truncates with >> 8, as the player always has.  1 and
+   2 add TPDF dither from two bytes of an xorshift32 generator (a
+   3-instruction LFSR on the ARM) and feed the total error, dither
+   less the truncated low byte, back so that it leaves through
+   1 - z^-1 or (1 - z^-1)^2.  That moves the noise from under quiet
+   passages up toward 18 kHz.  The error is taken before clamping,
+   so the loop stays stable when the output clips.  This
+   costs about 14 (first order) or 16 (second order) more cycles per
+   output byte; tools/dithspec.c measures the result. */
+#ifndef GSM_DITHER
+#define GSM_DITHER 0
+#endif
 
-		    word		* Ncr,		/* [0..3] 		IN 	*/
-		    word		* bcr,		/* [0..3]		IN	*/
-		    word		* Mcr,		/* [0..3] 		IN 	*/
-		    word		* xmaxcr,	/* [0..3]		IN 	*/
-		    word		* xMcr,		/* [0..13*4]		IN	*/
+#if GSM_DITHER
+#if GSM_DITHER == 2
+#define DITHER_SHAPE		(2 * e1 - e2)
+#define DITHER_KEEP(e)		(e2 = e1, e1 = (e))
+#else
+#define DITHER_SHAPE		e1
+#define DITHER_KEEP(e)		(e1 = (e))
+#endif
 
-		    word		* s)		/* [0..159]		OUT 	*/
+#define UPS_PUT(v) do { \
+    register int d, w; \
+    rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; \
+    d = (int)(rnd & 0xFF) - (int)((rnd >> 8) & 0xFF); \
+    w = (v) - DITHER_SHAPE + d; \
+    DITHER_KEEP(d - (w & 0xFF)); \
+    w >>= 8; \
+    *dst++ = UPS_CLAMP_S8(w); \
+  } while (0)
+#define UPS_PUT_WIDE(v)		UPS_PUT(v)
+#else
+#define UPS_PUT(v)		(*dst++ = (v) >> 8)
+#define UPS_PUT_WIDE(v) do { \
+    register int w = (v) >> 8; \
+    *dst++ = UPS_CLAMP_S8(w); \
+  } while (0)
+#endif
 
+/* Lanczos-4 taps at 1/2, 3/2, 5/2, 7/2 in 1.15; the pairs sum to 1 */
+#define UPS_FIR_C0 20280
+#define UPS_FIR_C1 (-5440)
+#define UPS_FIR_C2 1958
+#define UPS_FIR_C3 (-414)
+
+static void Postprocessing_s8 P4((S,s,n,dst),
+				 struct gsm_state	* S,
+				 register const word	* s,
+				 int			n,
+				 register signed char	* dst)
 {
-  int j, k;
-  word erp[40], wt[160];
-  word *drp = S->dp0 + 120;
-
-  for (j=0; j <= 3; j++, xmaxcr++, bcr++, Ncr++, Mcr++, xMcr += 13) {
-    PROFILE_COLOR(31, 23, 0);
-    Gsm_RPE_Decoding( S, *xmaxcr, *Mcr, xMcr, erp );
-    PROFILE_COLOR(0, 23, 31);
-    Gsm_Long_Term_Synthesis_Filtering( S, *Ncr, *bcr, erp, drp );
-    PROFILE_COLOR(0, 23, 23);
-    {
-      word *wt_cur = wt + j * 40;
-      for (k = 0; k <= 39; k++)
-        *wt_cur++  =  drp[ k ];
-    }
+  register word		msr = S->msr;
+  register longword	ltmp;	/* for GSM_ADD */
+  register word		tmp;
+  register int		cur;
+#if GSM_DITHER
+  register unsigned int	rnd = S->dith_rnd | 1;	/* never 0 */
+  register int		e1 = S->dith_err[0];
+#if GSM_DITHER == 2
+  register int		e2 = S->dith_err[1];
+#endif
+#endif
+
+#if GSM_UPSAMPLE_TAPS == 8
+  register int		h0 = S->ups_hist[0], h1 = S->ups_hist[1];
+  register int		h2 = S->ups_hist[2], h3 = S->ups_hist[3];
+  register int		h4 = S->ups_hist[4], h5 = S->ups_hist[5];
+  register int		h6 = S->ups_hist[6];
+  register longword	mid;
+
+  while (n--) {
+    POSTPROC_NEXT(cur);
+
+    mid = UPS_FIR_C0 * (longword)(h3 + h4)
+        + UPS_FIR_C1 * (longword)(h2 + h5)
+        + UPS_FIR_C2 * (longword)(h1 + h6)
+        + UPS_FIR_C3 * (longword)(h0 + cur);
+    UPS_PUT_WIDE(mid >> 15);
+    UPS_PUT(h4);
+    h0 = h1; h1 = h2; h2 = h3; h3 = h4; h4 = h5; h5 = h6; h6 = cur;
+  }
+  S->ups_hist[0] = h0; S->ups_hist[1] = h1; S->ups_hist[2] = h2;
+  S->ups_hist[3] = h3; S->ups_hist[4] = h4; S->ups_hist[5] = h5;
+  S->ups_hist[6] = h6;
+  S->ups_last = h3;
+
+#elif GSM_UPSAMPLE_TAPS == 4
+  register int		h0 = S->ups_hist[0], h1 = S->ups_hist[1];
+  register int		h2 = S->ups_hist[2];
+  register int		mid;
+
+  while (n--) {
+    POSTPROC_NEXT(cur);
+
+    mid = (9 * (h1 + h2) - (h0 + cur)) >> 4;
+    UPS_PUT_WIDE(mid);
+    UPS_PUT(h2);
+    h0 = h1; h1 = h2; h2 = cur;
   }
+  S->ups_hist[0] = h0; S->ups_hist[1] = h1; S->ups_hist[2] = h2;
+  S->ups_last = h1;
+
+#else
+  register int		last = S->ups_last;
+
+  while (n--) {
+    POSTPROC_NEXT(cur);
 
-  /* Goes hot pink then yellow here */
+    UPS_PUT((last + cur) >> 1);	   /* 2:1 linear interpolation */
+    UPS_PUT(cur);
+    last = cur;
+  }
+  S->ups_last = last;
+#endif
+
+#if GSM_DITHER
+  S->dith_rnd = rnd;
+  S->dith_err[0] = e1;
+#if GSM_DITHER == 2
+  S->dith_err[1] = e2;
+#endif
+#endif
+  S->msr = msr;
+}
+
+static void Gsm_Decoder P3((S, p, s),
+		    struct gsm_state	* S,
+		    struct gsm_params	* p,		/* 		IN	*/
+		    word		* s)		/* [0..159]		OUT 	*/
+
+{
+  int j;
+  word erp[40];
+  struct gsm_subframe_params *sp = p->sub;
+
+  for (j=0; j <= 3; j++, sp++) {
+    word *drp = S->dp0 + j * 40;
+
+    PROF_BEGIN(PROF_RPE);
+    Gsm_RPE_Decoding( S, sp->xmaxc, sp->Mc, sp->xmc, erp );
+    PROF_END(PROF_RPE);
+    PROF_BEGIN(PROF_LTP);
+    Gsm_Long_Term_Synthesis_Filtering( S, sp->Nc, sp->bc, erp, drp );
+    PROF_END(PROF_LTP);
+  }
 
   /* vba seems to think gsm spends most of its time in Gsm_STSF */
-  Gsm_Short_Term_Synthesis_Filter( S, LARcr, wt, s );
-  Postprocessing(S, s);
+  /* The LTP ring holds exactly this frame's residual drp[0..159]
+     in order, so STSF reads it from there without a copy. */
+  PROF_BEGIN(PROF_STSF);
+  Gsm_Short_Term_Synthesis_Filter( S, p->LARc, S->dp0, s );
+  PROF_END(PROF_STSF);
 }
 
 
@@ -633,119 +743,187 @@ gsm gsm_create P0()
 
 /* begin gsm_decode.c ********************/
 
-__attribute__((long_call)) int gsm_decode P3((s, c, target), gsm s, gsm_byte * c, gsm_signal * target)
+/* Unpack_frame() pulls the 76 parameters out of a 33-byte frame.
+
+   Reading the frame a byte at a time through *c costs about two ROM
+   loads per byte, because every store to a word array might alias
+   the gsm_byte source and forces a reload.  Instead, each byte gets
+   loaded exactly once into a 32-bit big-endian window and the fields
+   come out with shifts and masks.  Frames sit 33 bytes apart in ROM,
+   so aligned word loads would need a funnel shift and a byte swap per
+   window, which costs more on the 16-bit cart bus than it saves.
+
+   The layout happens to fall on byte boundaries: 4 bits of magic
+   and 36 bits of LARc fill bytes 0-4, and each subframe is exactly
+   7 bytes.  A subframe splits into a 32-bit window holding Nc, bc,
+   Mc, xmaxc, and xmc[0..4], and a 24-bit window holding xmc[5..12].
+ */
+
+#define BE32(c) ((ulongword)(c)[0] << 24 | (ulongword)(c)[1] << 16 \
+		 | (ulongword)(c)[2] << 8 | (c)[3])
+
+static void Unpack_frame P2((c, p), const gsm_byte * c, struct gsm_params * p)
+{
+  register ulongword	hi, lo;
+  register word		* xmc;
+  struct gsm_subframe_params * sp = p->sub;
+  int			j;
+
+  hi = BE32(c);
+  lo = c[4];
+  p->LARc[0] = (hi >> 22) & 0x3F;
+  p->LARc[1] = (hi >> 16) & 0x3F;
+  p->LARc[2] = (hi >> 11) & 0x1F;
+  p->LARc[3] = (hi >> 6) & 0x1F;
+  p->LARc[4] = (hi >> 2) & 0xF;
+  p->LARc[5] = (hi & 0x3) << 2 | lo >> 6;
+  p->LARc[6] = (lo >> 3) & 0x7;
+  p->LARc[7] = lo & 0x7;
+
+  for (c += 5, j = 0; j <= 3; j++, sp++, c += 7) {
+    hi = BE32(c);
+    lo = (ulongword)c[4] << 16 | (ulongword)c[5] << 8 | c[6];
+    xmc = sp->xmc;
+
+    sp->Nc    = (hi >> 25) & 0x7F;
+    sp->bc    = (hi >> 23) & 0x3;
+    sp->Mc    = (hi >> 21) & 0x3;
+    sp->xmaxc = (hi >> 15) & 0x3F;
+    xmc[0]  = (hi >> 12) & 0x7;
+    xmc[1]  = (hi >> 9) & 0x7;
+    xmc[2]  = (hi >> 6) & 0x7;
+    xmc[3]  = (hi >> 3) & 0x7;
+    xmc[4]  = hi & 0x7;
+    xmc[5]  = (lo >> 21) & 0x7;
+    xmc[6]  = (lo >> 18) & 0x7;
+    xmc[7]  = (lo >> 15) & 0x7;
+    xmc[8]  = (lo >> 12) & 0x7;
+    xmc[9]  = (lo >> 9) & 0x7;
+    xmc[10] = (lo >> 6) & 0x7;
+    xmc[11] = (lo >> 3) & 0x7;
+    xmc[12] = lo & 0x7;
+  }
+}
+
+#undef BE32
+
+/* Decode_frame() decodes everything except Postprocessing(), so
+   the caller can finish the frame with gsm_postprocess_s8(). */
+
+static int Decode_frame P3((s, c, target), gsm s, const gsm_byte * c, gsm_signal * target)
 {
-  word  	LARc[8], Nc[4], Mc[4], bc[4], xmaxc[4], xmc[13*4];
+  struct gsm_params	p;
 
   if (((*c >> 4) & 0x0F) != GSM_MAGIC) return -1;
 
-  PROFILE_COLOR(31, 0, 0);
-
-  LARc[0]  = (*c++ & 0xF) << 2;		/* 1 */
-  LARc[0] |= (*c >> 6) & 0x3;
-  LARc[1]  = *c++ & 0x3F;
-  LARc[2]  = (*c >> 3) & 0x1F;
-  LARc[3]  = (*c++ & 0x7) << 2;
-  LARc[3] |= (*c >> 6) & 0x3;
-  LARc[4]  = (*c >> 2) & 0xF;
-  LARc[5]  = (*c++ & 0x3) << 2;
-  LARc[5] |= (*c >> 6) & 0x3;
-  LARc[6]  = (*c >> 3) & 0x7;
-  LARc[7]  = *c++ & 0x7;
-  Nc[0]  = (*c >> 1) & 0x7F;
-  bc[0]  = (*c++ & 0x1) << 1;
-  bc[0] |= (*c >> 7) & 0x1;
-  Mc[0]  = (*c >> 5) & 0x3;
-  xmaxc[0]  = (*c++ & 0x1F) << 1;
-  xmaxc[0] |= (*c >> 7) & 0x1;
-  xmc[0]  = (*c >> 4) & 0x7;
-  xmc[1]  = (*c >> 1) & 0x7;
-  xmc[2]  = (*c++ & 0x1) << 2;
-  xmc[2] |= (*c >> 6) & 0x3;
-  xmc[3]  = (*c >> 3) & 0x7;
-  xmc[4]  = *c++ & 0x7;
-  xmc[5]  = (*c >> 5) & 0x7;
-  xmc[6]  = (*c >> 2) & 0x7;
-  xmc[7]  = (*c++ & 0x3) << 1;		/* 10 */
-  xmc[7] |= (*c >> 7) & 0x1;
-  xmc[8]  = (*c >> 4) & 0x7;
-  xmc[9]  = (*c >> 1) & 0x7;
-  xmc[10]  = (*c++ & 0x1) << 2;
-  xmc[10] |= (*c >> 6) & 0x3;
-  xmc[11]  = (*c >> 3) & 0x7;
-  xmc[12]  = *c++ & 0x7;
-  Nc[1]  = (*c >> 1) & 0x7F;
-  bc[1]  = (*c++ & 0x1) << 1;
-  bc[1] |= (*c >> 7) & 0x1;
-  Mc[1]  = (*c >> 5) & 0x3;
-  xmaxc[1]  = (*c++ & 0x1F) << 1;
-  xmaxc[1] |= (*c >> 7) & 0x1;
-  xmc[13]  = (*c >> 4) & 0x7;
-  xmc[14]  = (*c >> 1) & 0x7;
-  xmc[15]  = (*c++ & 0x1) << 2;
-  xmc[15] |= (*c >> 6) & 0x3;
-  xmc[16]  = (*c >> 3) & 0x7;
-  xmc[17]  = *c++ & 0x7;
-  xmc[18]  = (*c >> 5) & 0x7;
-  xmc[19]  = (*c >> 2) & 0x7;
-  xmc[20]  = (*c++ & 0x3) << 1;
-  xmc[20] |= (*c >> 7) & 0x1;
-  xmc[21]  = (*c >> 4) & 0x7;
-  xmc[22]  = (*c >> 1) & 0x7;
-  xmc[23]  = (*c++ & 0x1) << 2;
-  xmc[23] |= (*c >> 6) & 0x3;
-  xmc[24]  = (*c >> 3) & 0x7;
-  xmc[25]  = *c++ & 0x7;
-  Nc[2]  = (*c >> 1) & 0x7F;
-  bc[2]  = (*c++ & 0x1) << 1;		/* 20 */
-  bc[2] |= (*c >> 7) & 0x1;
-  Mc[2]  = (*c >> 5) & 0x3;
-  xmaxc[2]  = (*c++ & 0x1F) << 1;
-  xmaxc[2] |= (*c >> 7) & 0x1;
-  xmc[26]  = (*c >> 4) & 0x7;
-  xmc[27]  = (*c >> 1) & 0x7;
-  xmc[28]  = (*c++ & 0x1) << 2;
-  xmc[28] |= (*c >> 6) & 0x3;
-  xmc[29]  = (*c >> 3) & 0x7;
-  xmc[30]  = *c++ & 0x7;
-  xmc[31]  = (*c >> 5) & 0x7;
-  xmc[32]  = (*c >> 2) & 0x7;
-  xmc[33]  = (*c++ & 0x3) << 1;
-  xmc[33] |= (*c >> 7) & 0x1;
-  xmc[34]  = (*c >> 4) & 0x7;
-  xmc[35]  = (*c >> 1) & 0x7;
-  xmc[36]  = (*c++ & 0x1) << 2;
-  xmc[36] |= (*c >> 6) & 0x3;
-  xmc[37]  = (*c >> 3) & 0x7;
-  xmc[38]  = *c++ & 0x7;
-  Nc[3]  = (*c >> 1) & 0x7F;
-  bc[3]  = (*c++ & 0x1) << 1;
-  bc[3] |= (*c >> 7) & 0x1;
-  Mc[3]  = (*c >> 5) & 0x3;
-  xmaxc[3]  = (*c++ & 0x1F) << 1;
-  xmaxc[3] |= (*c >> 7) & 0x1;
-  xmc[39]  = (*c >> 4) & 0x7;
-  xmc[40]  = (*c >> 1) & 0x7;
-  xmc[41]  = (*c++ & 0x1) << 2;
-  xmc[41] |= (*c >> 6) & 0x3;
-  xmc[42]  = (*c >> 3) & 0x7;
-  xmc[43]  = *c++ & 0x7;			/* 30  */
-  xmc[44]  = (*c >> 5) & 0x7;
-  xmc[45]  = (*c >> 2) & 0x7;
-  xmc[46]  = (*c++ & 0x3) << 1;
-  xmc[46] |= (*c >> 7) & 0x1;
-  xmc[47]  = (*c >> 4) & 0x7;
-  xmc[48]  = (*c >> 1) & 0x7;
-  xmc[49]  = (*c++ & 0x1) << 2;
-  xmc[49] |= (*c >> 6) & 0x3;
-  xmc[50]  = (*c >> 3) & 0x7;
-  xmc[51]  = *c & 0x7;			/* 33 */
-
-  Gsm_Decoder(s, LARc, Nc, bc, Mc, xmaxc, xmc, target);
+  PROF_BEGIN(PROF_UNPACK);
+  Unpack_frame(c, &p);
+  PROF_END(PROF_UNPACK);
+  Gsm_Decoder(s, &p, target);
 
+  PROF_COMMIT(PROF_UNPACK);
+  PROF_COMMIT(PROF_RPE);
+  PROF_COMMIT(PROF_LTP);
+  PROF_COMMIT(PROF_STSF);
   return 0;
 }
 
+__attribute__((long_call)) int gsm_decode P3((s, c, target), gsm s, const gsm_byte * c, gsm_signal * target)
+{
+  if (Decode_frame(s, c, target)) return -1;
+  Postprocessing(s, target);
+  return 0;
+}
+
+__attribute__((long_call)) int gsm_decode_raw P3((s, c, target), gsm s, const gsm_byte * c, gsm_signal * target)
+{
+  return Decode_frame(s, c, target);
+}
+
+/* gsm_decode_n(), gsm_decode_raw_n() **
+   Decode n consecutive 33-byte frames into 160 * n samples with one
+   call into IWRAM.  Returns the number of frames decoded, which is
+   less than n only if a frame has a bad magic number.
+*/
+
+__attribute__((long_call)) int gsm_decode_n P4((s, c, n, target), gsm s, const gsm_byte * c, int n, gsm_signal * target)
+{
+  int done;
+
+  for (done = 0; done < n; done++) {
+    if (Decode_frame(s, c, target)) break;
+    Postprocessing(s, target);
+    c += sizeof(gsm_frame);
+    target += 160;
+  }
+  return done;
+}
+
+__attribute__((long_call)) int gsm_decode_raw_n P4((s, c, n, target), gsm s, const gsm_byte * c, int n, gsm_signal * target)
+{
+  int done;
+
+  for (done = 0; done < n; done++) {
+    if (Decode_frame(s, c, target)) break;
+    c += sizeof(gsm_frame);
+    target += 160;
+  }
+  return done;
+}
+
+/* gsm_postprocess_s8() ****************
+   Runs n samples of gsm_decode_raw() output through Postprocessing(),
+   2:1 upsampling and narrowing, writing 2 * n signed bytes.  A frame
+   may be finished in several pieces, as long as they are in order.
+*/
+
+__attribute__((long_call)) void gsm_postprocess_s8 P4((s, src, n, dst), gsm s, const gsm_signal * src, int n, signed char * dst)
+{
+  PROF_BEGIN(PROF_POST);
+  Postprocessing_s8(s, src, n, dst);
+  PROF_END(PROF_POST);
+}
+
+/* begin gsm_snapshot.c ********************/
+
+/* gsm_snapshot_save() and gsm_snapshot_load() ****************
+   Copy the part of the decoder state that carries from one frame to
+   the next, as of a frame boundary.  tools/gbfs.c saves these into a
+   song's seek table and the player loads them to seek.  The 2:1
+   upsampler and dither state stay as they are, which keeps the
+   output continuous across a seek.
+*/
+
+__attribute__((long_call)) void gsm_snapshot_save P2((s, snap), gsm s, struct gsm_snapshot * snap)
+{
+  int i;
+
+  for (i = 0; i < GSM_DRP_RING - 40; i++) snap->dp0[i] = s->dp0[i + 40];
+  for (i = 0; i < 8; i++) {
+    snap->LARpp[0][i] = s->LARpp[0][i];
+    snap->LARpp[1][i] = s->LARpp[1][i];
+  }
+  snap->j = s->j;
+  snap->nrp = s->nrp;
+  for (i = 0; i < 9; i++) snap->v[i] = s->v[i];
+  snap->msr = s->msr;
+}
+
+__attribute__((long_call)) void gsm_snapshot_load P2((s, snap), gsm s, const struct gsm_snapshot * snap)
+{
+  int i;
+
+  for (i = 0; i < GSM_DRP_RING - 40; i++) s->dp0[i + 40] = snap->dp0[i];
+  for (i = 0; i < 8; i++) {
+    s->LARpp[0][i] = snap->LARpp[0][i];
+    s->LARpp[1][i] = snap->LARpp[1][i];
+  }
+  s->j = snap->j;
+  s->nrp = snap->nrp;
+  for (i = 0; i < 9; i++) s->v[i] = snap->v[i];
+  s->msr = snap->msr;
+}
+
 #if 0
 
 /* begin gsm_destroy.c ********************/
@@ -15,44 +15,54 @@
 #include "private.h" /* for sizeof(struct gsm_state) */
 
 #include "gbfs.h"
+#include "hal.h"
+#include "profile.h"
+#include "telemetry.h"
+
+/* Audio goes out through a ring of DSOUND_SEGS segments, each one
+   video frame (608 samples) long.  DMA1 feeds FIFO A from the ring
+   without a break, and TIMER[1] counts TIMER[0] overflows to raise an
+   IRQ at the end of every segment.  isr() answers it by running
+   dsound_refill(), which decodes into every free segment.  The main
+   loop can take as long as it likes over a cover, and decoding stays
+   up to DSOUND_SEGS - 1 video frames ahead of the speaker to ride out
+   a slow frame or a stretch with INTENABLE off.
+
+   dsound_played counts segments handed to the FIFO and dsound_filled
+   counts segments decoded; the one the DMA is reading is
+   dsound_played & (DSOUND_SEGS - 1).  Both only ever increase.
+
+   Pausing stops decoding where it is.  dsound_fill_silence() ramps
+   what is left down to 0 and streaming_run() stops the sample clock
+   and DMA1 once the DMA reaches the silence, then halts on the keypad
+   IRQ.  Resuming starts the ring over from init_sound(), and the
+   first decoded segment fades in from 0.
+*/
+#define DSOUND_SEGS 4		/* power of 2, at least 2 */
+#define DSOUND_SEG_LEN 608
+#define DSOUND_FIFO_SLACK 32	/* bytes DMA1 may fetch past a segment */
 
-void isr(void);
-
-#if 0
-#define PROFILE_WAIT_Y(y) \
-	do                    \
-	{                     \
-	} while (LCD_Y != (y))
-#define PROFILE_COLOR(r, g, b) (PALRAM[0] = RGB((r), (g), (b)))
-#else
-#define PROFILE_WAIT_Y(y) ((void)0)
-#define PROFILE_COLOR(r, g, b) ((void)0)
-#endif
-
-static void dsound_switch_buffers(const void *src)
-{
-	DMA[1].control = 0;
-
-	/* no-op to let DMA registers catch up */
-	asm volatile("eor r0, r0; eor r0, r0" ::
-					 : "r0");
+signed char dsound_ring[DSOUND_SEGS * DSOUND_SEG_LEN + DSOUND_FIFO_SLACK]
+	__attribute__((aligned(4)));
+volatile unsigned int dsound_played, dsound_filled, dsound_underruns;
+static volatile int dsound_refilling;
 
-	DMA[1].src = src;
-	DMA[1].dst = (void *)0x040000a0; /* write to FIFO A address */
-	DMA[1].count = 1;
-	DMA[1].control = DMA_DSTUNCH | DMA_SRCINC | DMA_REPEAT | DMA_U32 |
-					 DMA_SPECIAL | DMA_ENABLE;
-}
+static signed char dsound_level;	/* last sample in the ring */
+static int dsound_fade_in;
+static volatile int dsound_quiet;	/* 0 from dsound_quiet_seg on */
+static volatile unsigned int dsound_quiet_seg;
+static int dsound_stopped;
 
 void init_sound(void)
 {
-	TIMER[0].control = 0;
-	//turn on sound circuit
-	SETSNDRES(1);
-	SNDSTAT = SNDSTAT_ENABLE;
-	DSOUNDCTRL = 0x0b0e;
-	TIMER[0].count = 0x10000 - (924 / 2);
-	TIMER[0].control = TIMER_16MHZ | TIMER_ENABLE;
+	hal_sound_init();
+
+	/* start with every segment holding silence */
+	memset(dsound_ring, 0, sizeof(dsound_ring));
+	dsound_played = 0;
+	dsound_filled = DSOUND_SEGS;
+	hal_fifo_start(dsound_ring);
+	hal_sound_start(DSOUND_SEG_LEN, 924 / 2);
 }
 
 /* gsm_init() **************
@@ -64,19 +74,218 @@ void gsm_init(gsm r)
 	r->nrp = 40;
 }
 
-void wait4vbl(void)
-{
-	asm volatile("mov r2, #0; swi 0x05" ::
-					 : "r0", "r1", "r2", "r3");
-}
-
 struct gsm_state decoder;
 const GBFS_FILE *fs;
-const char *src;
+
+const gsm_byte *src;
 unsigned int src_len;
 
-signed short out_samples[160];
-signed char double_buffers[2][608] __attribute__((aligned(4)));
+/* the stream dsound_refill() decodes from; change only with
+   INTENABLE off */
+const gsm_byte *volatile src_pos = NULL;
+const gsm_byte *volatile src_end = NULL;
+volatile int dsound_paused = 0;
+
+/* Frames decoded per gsm_decode_raw_n() call.  Two frames are 320
+   samples, enough for the 304 that one DMA segment plays, so
+   dsound_fill_seg() calls into the decoder at most once per segment.
+   The makefile's DECODE_BATCH overrides it to compare batch sizes
+   with PROFILE = 1: PROF_SEG's mean per segment is the number to
+   watch.  Each call a batch avoids saves the long_call veneer and
+   the decoder's register saves, about 60 cycles.  At one frame per
+   call that is 0.04% of the CPU.  So a batch above 2 buys almost
+   nothing, while a batch of 8 puts about 470,000 cycles of decoding
+   into one TIMER1 IRQ, more than the 280,000 a segment takes to
+   play. */
+#ifndef DECODE_BATCH
+#define DECODE_BATCH 2
+#endif
+#define OUT_SAMPLES_LEN (160 * DECODE_BATCH)
+
+signed short out_samples[OUT_SAMPLES_LEN];
+static volatile unsigned int decode_pos = OUT_SAMPLES_LEN;
+/* samples in out_samples from the last call, fewer than
+   OUT_SAMPLES_LEN only if the song ended partway into the batch */
+static volatile unsigned int decode_len = OUT_SAMPLES_LEN;
+
+/* dsound_fill_silence() **************
+   Ramps dst from the last sample down to 0, or fills it with 0 if the
+   ramp is done.  dsound_refill() calls this for segment dsound_filled.
+*/
+static void dsound_fill_silence(signed char *dst)
+{
+	int level = dsound_level << 16;
+	int step = -level / DSOUND_SEG_LEN;
+	unsigned int i;
+
+	dsound_fade_in = 1;
+	if (dsound_level == 0)
+	{
+		memset(dst, 0, DSOUND_SEG_LEN);
+		if (!dsound_quiet)
+		{
+			dsound_quiet_seg = dsound_filled;
+			dsound_quiet = 1;
+		}
+		return;
+	}
+	for (i = 0; i < DSOUND_SEG_LEN; i++)
+	{
+		level += step;
+		dst[i] = (level + 0x8000) >> 16;
+	}
+	dsound_level = 0;
+}
+
+/* dsound_fade() **************
+   Scales dst up from 0 to full over the segment.
+*/
+static void dsound_fade(signed char *dst)
+{
+	unsigned int i;
+	int gain = 0;
+
+	for (i = 0; i < DSOUND_SEG_LEN; i++)
+	{
+		dst[i] = dst[i] * gain >> 16;
+		gain += 0x10000 / DSOUND_SEG_LEN;
+	}
+}
+
+/* dsound_fill_seg() **************
+   Decodes the next DSOUND_SEG_LEN samples of the stream into dst, or
+   goes silent while paused or past the end.
+*/
+static void dsound_fill_seg(signed char *dst_pos)
+{
+	signed char *dst = dst_pos;
+	unsigned int left = DSOUND_SEG_LEN / 2;
+	const gsm_byte *pos = src_pos;
+	const gsm_byte *end = src_end;
+
+	/* pos runs up to DECODE_BATCH frames ahead of what has been
+	   played, so the song is over only once out_samples is used up */
+	if (dsound_paused || (pos >= end && decode_pos >= decode_len))
+	{
+		dsound_fill_silence(dst);
+		return;
+	}
+
+	/* Postprocessing, 2:1 linear interpolation, and narrowing all
+	   happen in gsm_postprocess_s8(), which writes straight into the
+	   DMA buffer. */
+	while (left > 0)
+	{
+		unsigned int n;
+
+		if (decode_pos >= decode_len)
+		{
+			if (pos < end)
+			{
+				unsigned int frames = (end - pos + sizeof(gsm_frame) - 1)
+				                      / sizeof(gsm_frame);
+
+				if (frames > DECODE_BATCH)
+					frames = DECODE_BATCH;
+				gsm_decode_raw_n(&decoder, pos, frames, out_samples);
+				hal_work(HAL_WORK_GSM_FRAME, frames);
+				decode_len = frames * 160;
+			}
+			else
+			{
+				/* the song ended partway into the segment; let the
+				   de-emphasis filter ring down to the end of it
+				   instead of replaying whatever the last batch left */
+				memset(out_samples, 0, sizeof(out_samples));
+				decode_len = left < OUT_SAMPLES_LEN ? left : OUT_SAMPLES_LEN;
+			}
+			pos += DECODE_BATCH * sizeof(gsm_frame);
+			decode_pos = 0;
+		}
+
+		n = decode_len - decode_pos;
+		if (n > left)
+			n = left;
+		gsm_postprocess_s8(&decoder, out_samples + decode_pos, n, dst_pos);
+		hal_work(HAL_WORK_PCM_SAMPLE, n);
+		decode_pos += n;
+		dst_pos += 2 * n;
+		left -= n;
+	}
+	src_pos = pos;
+	if (dsound_fade_in)
+	{
+		dsound_fade(dst);
+		dsound_fade_in = 0;
+	}
+	dsound_level = dst[DSOUND_SEG_LEN - 1];
+	dsound_quiet = 0;
+	PROF_COMMIT(PROF_POST);
+}
+
+/* dsound_segment_done() **************
+   Called from isr() on each TIMER[1] IRQ, when the FIFO has played
+   another segment.  Restarts DMA1 at the top of the ring after the
+   last segment and counts an underrun if the segment coming up was
+   never decoded.  Returns nonzero if the caller should run
+   dsound_refill(), which it must then do.
+*/
+int dsound_segment_done(void)
+{
+	unsigned int played = dsound_played + 1;
+	int lead = (int)(dsound_filled - played);
+
+	if ((played & (DSOUND_SEGS - 1)) == 0)
+		hal_fifo_start(dsound_ring);
+	/* the first segment after the silence init_sound() queued */
+	if (played == DSOUND_SEGS && !tele.boot_audio_cycles)
+		tele.boot_audio_cycles = hal_cycles();
+	if (lead <= 0)
+		dsound_underruns++;
+	tele_segment(lead);
+	dsound_played = played;
+
+	if (dsound_refilling)
+		return 0;
+	dsound_refilling = 1;
+	return 1;
+}
+
+/* dsound_refill() **************
+   Decodes into every segment the FIFO is done with.  Runs with IRQs
+   on, so dsound_played can move while it works; if the DMA has caught
+   up, the segment it is reading is lost and decoding resumes after it.
+*/
+void dsound_refill(void)
+{
+	for (;;)
+	{
+		unsigned int played = dsound_played;
+		unsigned int seg;
+		u32 t0;
+
+		if ((int)(dsound_filled - played) <= 0)
+			dsound_filled = played + 1;
+		if (dsound_filled - played >= DSOUND_SEGS)
+			break;
+
+		seg = dsound_filled & (DSOUND_SEGS - 1);
+		t0 = hal_cycles();
+		PROF_BEGIN(PROF_SEG);
+		dsound_fill_seg(dsound_ring + seg * DSOUND_SEG_LEN);
+		PROF_END(PROF_SEG);
+		PROF_COMMIT(PROF_SEG);
+		tele_fill(hal_cycles() - t0);
+
+		/* DMA1 runs a little past the last segment before
+		   dsound_segment_done() moves it back to the top */
+		if (seg == 0)
+			memcpy(dsound_ring + DSOUND_SEGS * DSOUND_SEG_LEN, dsound_ring,
+			       DSOUND_FIFO_SLACK);
+		dsound_filled++;
+	}
+	dsound_refilling = 0;
+}
 
 #if 0
 
@@ -126,36 +335,248 @@ void pre_decode_run(void)
     }
   PALRAM[0] = RGB(0, 31, 0);
 
-  dsound_switch_buffers(EWRAM);
+  hal_fifo_start(EWRAM);
 
 }
 #endif
 
+/* The seek table that tools/gbfs.c appends to each song (see
+   private.h).  Seeking restores the nearest snapshot and decodes on
+   from there, so a jump never plays LTP history from another part of
+   the song.  seek_snaps is NULL for a song packed without one. */
+const struct gsm_snapshot *seek_snaps;
+unsigned int seek_n_snaps, seek_interval;
+unsigned int seek_snap;		/* snapshot decoding last started from */
+
+/* seek_open() **************
+   Finds the seek table at the end of the song at src and trims
+   src_end to the frames before it.  A trailer whose offsets don't
+   fit inside the song is ignored, and the whole object plays as
+   frames.  Call with INTENABLE off.
+*/
+static void seek_open(void)
+{
+	const u32 *trailer = (const u32 *)(src + src_len) - 4;
+
+	seek_snaps = NULL;
+	seek_n_snaps = 0;
+	seek_snap = 0;
+	src_end = src + src_len;
+	if (src_len < GSM_SEEK_TRAILER_LEN || (src_len & 3)
+	    || trailer[3] != GSM_SEEK_MAGIC
+	    || trailer[1] > src_len - GSM_SEEK_TRAILER_LEN
+	    || trailer[0] > trailer[1] || trailer[2] == 0)
+		return;
+
+	src_end = src + trailer[0];
+	seek_snaps = (const struct gsm_snapshot *)(src + trailer[1]);
+	seek_n_snaps = (src_len - GSM_SEEK_TRAILER_LEN - trailer[1])
+	               / sizeof(struct gsm_snapshot);
+	seek_interval = trailer[2];
+}
+
+/* seek_restore() **************
+   Restarts decoding at snapshot k, that is, at frame
+   k * seek_interval with the decoder state saved there.  Snapshot 0
+   is the start of the song.  Call with INTENABLE off.
+*/
+static void seek_restore(unsigned int k)
+{
+	if (k > seek_n_snaps)
+		k = seek_n_snaps;
+	if (k == 0)
+		gsm_init(&decoder);
+	else
+		gsm_snapshot_load(&decoder, seek_snaps + k - 1);
+	src_pos = src + k * seek_interval * sizeof(gsm_frame);
+	decode_pos = OUT_SAMPLES_LEN;
+	seek_snap = k;
+}
+
+/* seek_to() **************
+   Seeks to the snapshot at or after frame (forward) or at or before
+   it (backward), unless decoding already started from there.
+*/
+static void seek_to(int frame, int forward)
+{
+	unsigned int k;
+
+	if (frame < 0)
+		frame = 0;
+	k = (unsigned int)frame / seek_interval;
+	if (forward && k * seek_interval < (unsigned int)frame)
+		k++;
+	if (k != seek_snap)
+		seek_restore(k);
+}
+
+/* Scrubbing.  While L or R is held, a target moves through the song
+   at a speed that doubles every SCRUB_RAMP video frames, from about
+   4x to about 67x.  Every SCRUB_BURST video frames decoding jumps to
+   the target and plays on from there at the normal rate, so what
+   comes out is a short burst of each part of the song passed over.
+   The decoder runs exactly as fast as in normal playback; the only
+   extra work is a 300-byte state reset per burst.
+
+   A burst can't start from the state the decoder would have had at
+   the target, so it starts from silence, as at the top of a song,
+   which costs a soft first frame rather than a squeal of LTP history
+   from elsewhere.  Letting go settles on a snapshot if the song has
+   a seek table. */
+#define SCRUB_TAP 50		/* frames moved on the first video frame */
+#define SCRUB_MIN_STEP 8	/* frames per video frame, about 4x */
+#define SCRUB_MAX_STEP 128
+#define SCRUB_RAMP 30
+#define SCRUB_BURST 4		/* about 8 frames, 70 ms of sound */
+
+/* scrub_step() **************
+   Returns how many frames the scrub target moves on the held'th
+   video frame that L or R has been held.
+*/
+static int scrub_step(unsigned int held)
+{
+	unsigned int shift = held / SCRUB_RAMP;
+
+	if (held == 0)
+		return SCRUB_TAP;
+	if (shift >= 4)
+		return SCRUB_MAX_STEP;
+	return SCRUB_MIN_STEP << shift;
+}
+
+/* scrub_jump() **************
+   Restarts decoding at frame with the filters silent.  Call with
+   INTENABLE off.
+*/
+static void scrub_jump(int frame)
+{
+	static struct gsm_snapshot silence = { {0}, {{0}}, 0, 40 };
+
+	silence.msr = decoder.msr;
+	gsm_snapshot_load(&decoder, &silence);
+	src_pos = src + frame * sizeof(gsm_frame);
+	decode_pos = OUT_SAMPLES_LEN;
+	seek_snap = (unsigned int)(-1);
+}
+
 #define CMD_START_SONG 0x0400
 
+/* The cover goes to VRAM in slices after each vblank, as many as
+   fit in COVER_BUDGET cycles from the vblank, and only while the
+   ring is far enough ahead that stalling the CPU for a DMA slice
+   can't starve it.  Time spent refilling the ring in the IRQ counts
+   against the budget, so a busy frame gets fewer slices.  A frame
+   is 280896 cycles.  How long changes take goes in the telemetry
+   record (see telemetry.h). */
+#define COVER_BUDGET 140800
+#define COVER_MIN_LEAD 2	/* segments queued */
+
+/* After SCREEN_OFF_FRAMES video frames with no key held, the screen
+   goes blank and the main loop stops drawing.  It then sleeps until
+   a key or the end of a segment instead of waking at every vblank,
+   just often enough to go on to the next song.  VRAM keeps the cover
+   and bar, so the key that turns the screen back on shows them at
+   once; that key does nothing else. */
+#define SCREEN_OFF_FRAMES 1800	/* 30 seconds */
+
 //void reset_gba(void) __attribute__((long_call));
 void hud_init(void);
-void hud_new_song(const char *name, GBFS_FILE *fs);
+const char *hud_cover_of(const char *name);
+unsigned int hud_find_cover(const char *name, const GBFS_FILE *fs,
+                            const void **cover, u32 *len);
+u32 hud_new_song(const void *cover, u32 len, unsigned int kind);
+u32 hud_cover_step(void);
+void hud_cover_flip(void);
+void hud_blank(int blank);
+void hud_bar(int right, int alert);
+extern u32 fracumul(u32, u32) __attribute__((long_call));
 void hud_frame(int locked, unsigned int t);
-void bmp16_rect(int left, int top, int right, int bottom, u32 clr, void *dstBase, u32 dstPitch);
+
+/* The track table, built once at boot, so that changing songs is
+   just indexing.  Every object in the GBFS file is a song except a
+   cover, whose name is a cover prefix (see hud.c) followed by the
+   name of an object that is there. */
+struct TRACK
+{
+	const char *name;		/* in the directory; 24 bytes, nul padded */
+	const gsm_byte *audio;
+	u32 audio_len;
+	const void *cover;
+	u32 cover_len;
+	unsigned int cover_kind;	/* from hud_find_cover(), 0 for none */
+};
+
+struct TRACK *tracks;
+unsigned int n_tracks;
+
+/* tracks_init() **************
+   Fills in tracks[] from the GBFS file fs.  Returns the number of
+   songs found.
+*/
+static unsigned int tracks_init(void)
+{
+	const GBFS_ENTRY *dir = (const GBFS_ENTRY *)((const char *)fs + fs->dir_off);
+	unsigned int n_objs = gbfs_count_objs(fs);
+	unsigned int i;
+
+	n_tracks = 0;
+	tracks = malloc(n_objs * sizeof(struct TRACK));
+	if (!tracks)
+		return 0;
+
+	for (i = 0; i < n_objs; i++)
+	{
+		struct TRACK *t = tracks + n_tracks;
+		const char *song;
+		char name[25];
+
+		t->audio = gbfs_get_nth_obj(fs, i, name, &t->audio_len);
+		song = hud_cover_of(name);
+		if (song && gbfs_get_obj(fs, song, NULL))
+			continue;
+		t->name = dir[i].name;
+		t->cover_kind = hud_find_cover(name, fs, &t->cover, &t->cover_len);
+		n_tracks++;
+	}
+	return n_tracks;
+}
 
 void streaming_run(void)
 {
-	const char *src_pos = NULL;
-	const char *src_end = NULL;
-	unsigned int decode_pos = 160, cur_buffer = 0;
 	unsigned short last_joy = 0x3ff;
 	unsigned int cur_song = (unsigned int)(-1);
-	int last_sample = 0;
 	int locked = 0;
-
+	int seek_frame = 0;
+	unsigned int scrub_held = 0, scrub_fwd = 0;
+	u32 cover_left = 0;
+	int loading = 0;
+	u32 wake = hal_cycles();
+	unsigned int idle_frames = 0;
+	int screen_off = 0;
+	u32 bar_scale = 0;		/* 232 * 2^32 / song length */
+
+	PROF_BEGIN(PROF_HUD);
 	while (1)
 	{
-		unsigned short j = (JOY & 0x3ff) ^ 0x3ff;
+		unsigned short j = hal_keys();
 		unsigned short cmd = j & (~last_joy | JOY_R | JOY_L);
-		signed char *dst_pos = double_buffers[cur_buffer];
 
 		last_joy = j;
+		if (j)
+		{
+			idle_frames = 0;
+			if (screen_off)
+			{
+				hud_blank(0);
+				screen_off = 0;
+				cmd = 0;
+			}
+		}
+		else if (!screen_off && ++idle_frames >= SCREEN_OFF_FRAMES)
+		{
+			hud_blank(1);
+			screen_off = 1;
+		}
 
 		/*      if((j & (JOY_A | JOY_B | JOY_SELECT | JOY_START))
          == (JOY_A | JOY_B | JOY_SELECT | JOY_START))
@@ -170,25 +591,53 @@ void streaming_run(void)
 		if (cmd & JOY_START)
 			locked ^= JOY_START;
 
-		if (cmd & JOY_L)
+		/* hold off dsound_refill() while the stream changes */
+		INTENABLE = 0;
+		dsound_paused = locked & JOY_START;
+		if (dsound_stopped && !dsound_paused)
 		{
-			src_pos -= 33 * 50;
-			if (src_pos < src)
-				cmd |= JOY_LEFT;
+			init_sound();
+			dsound_stopped = 0;
+		}
+		else if (dsound_paused && !dsound_stopped && dsound_quiet
+		         && (int)(dsound_played - dsound_quiet_seg) >= 0)
+		{
+			/* the DMA is into the silence */
+			hal_sound_stop();
+			dsound_stopped = 1;
 		}
 
-		if (cmd & JOY_R)
+		if (cmd & (JOY_L | JOY_R))
 		{
-			src_pos += 33 * 50;
+			int step = scrub_step(scrub_held);
+
+			scrub_fwd = cmd & JOY_R;
+			if (!scrub_held)
+				seek_frame = (src_pos - src) / sizeof(gsm_frame);
+			seek_frame += scrub_fwd ? step : -step;
+			if (seek_frame < 0)
+				cmd |= JOY_LEFT;
+			else if (src + seek_frame * sizeof(gsm_frame) >= src_end)
+				cmd |= JOY_RIGHT;
+			else if (scrub_held % SCRUB_BURST == 0)
+				scrub_jump(seek_frame);
+			scrub_held++;
+		}
+		else if (scrub_held)
+		{
+			if (seek_snaps)
+				seek_to(seek_frame, scrub_fwd);
+			scrub_held = 0;
 		}
 
-		if (src_pos >= src_end)
+		/* src_pos runs a batch ahead, so let out_samples play out */
+		if (src_pos >= src_end && decode_pos >= decode_len)
 			cmd |= JOY_RIGHT;
 
 		if (cmd & JOY_RIGHT)
 		{
 			cur_song++;
-			if (cur_song >= (gbfs_count_objs(fs)/2))
+			if (cur_song >= n_tracks)
 				cur_song = 0;
 			cmd |= CMD_START_SONG;
 		}
@@ -196,7 +645,7 @@ void streaming_run(void)
 		if (cmd & JOY_LEFT)
 		{
 			if (cur_song == 0)
-				cur_song = (gbfs_count_objs(fs)/2) - 1;
+				cur_song = n_tracks - 1;
 			else
 				cur_song--;
 			cmd |= CMD_START_SONG;
@@ -204,72 +653,75 @@ void streaming_run(void)
 
 		if (cmd & CMD_START_SONG)
 		{
-			char name[25];
 			gsm_init(&decoder);
-			src = gbfs_get_nth_obj(fs, cur_song, name, &src_len);
-			//hud_new_song(name, cur_song + 1);
-			hud_new_song(name, fs);
-			if (cmd & JOY_L)
-				src_pos = src + src_len - 33 * 60;
+			src = tracks[cur_song].audio;
+			src_len = tracks[cur_song].audio_len;
+			seek_open();
+			src_pos = src;
+			if (src_end - src > 232)
+				bar_scale = ((unsigned long long)232 << 32)
+				            / (u32)(src_end - src);
 			else
-				src_pos = src;
-			src_end = src + src_len;
+				bar_scale = src_end > src ? 0xffffffffU : 0;
+			if (cmd & JOY_L)
+			{
+				int last = (int)((src_end - src) / sizeof(gsm_frame)) - 60;
+
+				if (last < 0)
+					last = 0;
+				if (seek_snaps)
+					seek_to(last, 0);
+				else
+					src_pos = src + last * sizeof(gsm_frame);
+			}
+			scrub_held = 0;
 		}
+		INTENABLE = 1;
 
-		PROFILE_WAIT_Y(0);
+		/* the ring keeps playing while the cover loads */
+		if (cmd & CMD_START_SONG)
+		{
+			const struct TRACK *t = tracks + cur_song;
 
-		// PALRAM[0] = RGB(22, 0, 0);
+			cover_left = hud_new_song(t->cover, t->cover_len, t->cover_kind);
+			loading = 1;
+		}
 
-		if (locked & JOY_START) /* if paused */
-			for (j = 304 / 2; j > 0; j--)
-			{
-				*dst_pos++ = last_sample >> 8;
-				*dst_pos++ = last_sample >> 8;
-				*dst_pos++ = last_sample >> 8;
-				*dst_pos++ = last_sample >> 8;
-			}
+		tele_frame(hal_cycles() - wake, cmd & CMD_START_SONG, loading);
+
+		PROF_END(PROF_HUD);
+		PROF_COMMIT(PROF_HUD);
+		prof_frame();
+
+		/* Nothing moves while the sound is stopped, so once the
+		   screen is off, sleep until a key instead of waking every
+		   vblank to read them.  Until then vblank must still wake
+		   the loop to count idle frames. */
+		if (screen_off && !hal_keys())
+			hal_wait_keys(dsound_stopped && !cover_left
+			              ? 0 : HAL_INT_TIMER1);
 		else
-			for (j = 304 / 4; j > 0; j--)
-			{
-				int cur_sample;
-				if (decode_pos >= 160)
-				{
-					if (src_pos < src_end)
-						gsm_decode(&decoder, src_pos, out_samples);
-					src_pos += sizeof(gsm_frame);
-					decode_pos = 0;
-				}
-
-				/* 2:1 linear interpolation */
-				cur_sample = out_samples[decode_pos++];
-				*dst_pos++ = (last_sample + cur_sample) >> 9;
-				*dst_pos++ = cur_sample >> 8;
-				last_sample = cur_sample;
-
-				cur_sample = out_samples[decode_pos++];
-				*dst_pos++ = (last_sample + cur_sample) >> 9;
-				*dst_pos++ = cur_sample >> 8;
-				last_sample = cur_sample;
-
-				cur_sample = out_samples[decode_pos++];
-				*dst_pos++ = (last_sample + cur_sample) >> 9;
-				*dst_pos++ = cur_sample >> 8;
-				last_sample = cur_sample;
-
-				cur_sample = out_samples[decode_pos++];
-				*dst_pos++ = (last_sample + cur_sample) >> 9;
-				*dst_pos++ = cur_sample >> 8;
-				last_sample = cur_sample;
-			}
+			hal_wait_vblank();
+		PROF_BEGIN(PROF_HUD);
+		wake = hal_cycles();
+		hud_cover_flip();
 
-		PROFILE_COLOR(27, 27, 27);
-		wait4vbl();
-		dsound_switch_buffers(double_buffers[cur_buffer]);
-		PROFILE_COLOR(27, 31, 27);
+		loading = cover_left != 0;
+		if (loading)
+		{
+			while (cover_left
+			       && (dsound_stopped
+			           || dsound_filled - dsound_played >= COVER_MIN_LEAD)
+			       && hal_cycles() - wake < COVER_BUDGET)
+				cover_left = hud_cover_step();
+		}
 
-		bmp16_rect(4,149, 4+(232*((src_pos-src)/((double)src_len))), 154, 0, 0x6000000, 480);
+		/* the bar turns red once the FIFO has run dry */
+		if (!screen_off)
+			hud_bar(4 + fracumul(src_pos - src, bar_scale),
+			        dsound_underruns);
 		//hud_frame(locked, src_pos - src); TODO: Add Progress bar here?
-		cur_buffer = !cur_buffer;
+		hal_work(HAL_WORK_MAIN_LOOP, 1);
 	}
 }
 
@@ -279,24 +731,28 @@ void copr_wait(void)
 
 	do
 	{
-		wait4vbl();
+		hal_wait_vblank();
 	} while (--vbls);
 }
 
+/* the simulator's own main() calls this */
+#ifdef HAL_HOST
+#define main player_main
+#endif
+
 int main(void)
 {
-	/* enable interrupts */
-	SET_MASTER_ISR(isr);
-	LCDSTAT = LCDSTAT_VBLIRQ;			 /* one plug to the display */
-	INTMASK = INT_VBLANK | INT_TIMER(1); /* the other to the isr */
-	INTENABLE = 1;						 /* and flip the switch */
-	fs = find_first_gbfs_file(find_first_gbfs_file);
-	if (!fs)
-	{
-		LCDMODE = 0;
-		PALRAM[0] = RGB(31, 0, 0);
-		while (1){}
-	}
+	u32 gbfs_cycles;
+
+	/* hal_cycles() counts from here on */
+	hal_init();
+	fs = hal_find_gbfs();
+	gbfs_cycles = hal_cycles();
+	tele_init();
+	tele.boot_gbfs_cycles = gbfs_cycles;
+	tele.boot_audio_cycles = 0;
+	if (!fs || !tracks_init())
+		hal_fatal(RGB(31, 0, 0));
 	LCDMODE = 0x0400 | 0x0003; //Set Screen to mode three
 	//gbfs_copy_obj(0x6000000, fs, "test1");
 	//hud_init();
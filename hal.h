@@ -0,0 +1,320 @@
+/* hal.h
+   the hardware services the GSM player uses
+*/
+
+/*
+ * Copyright 2026 GBAWAVE contributors.
+ * See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+ * THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+ */
+
+/* gsmplay.c, hud.c, and isr.c go through these for sound, timing,
+   input, interrupts, and DMA instead of writing pin8gba.h registers
+   themselves.  On the GBA they are inline and compile to the same
+   register accesses as before.
+
+   With HAL_HOST defined they are functions in hal_host.c, which runs
+   the player on a PC against a simulated clock, and VRAM, PALRAM,
+   MAP, BGCTRL, LCDMODE, LCD_Y, and INTENABLE point at its copies
+   instead of at the I/O area.  hal_work() tells the simulator what
+   the code has just done so that it can charge cycles for it.
+
+   TIMER[2] counts CPU cycles and TIMER[3] counts its overflows,
+   which hal_cycles() reads as one 32-bit count.  hal_ticks() is the
+   same clock in 64-cycle ticks. */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stddef.h>
+#include "pin8gba.h"
+#include "gbfs.h"
+
+/* kinds of work hal_work() charges for */
+enum HAL_WORK
+{
+  HAL_WORK_GSM_FRAME,   /* a frame through gsm_decode_raw_n() */
+  HAL_WORK_PCM_SAMPLE,  /* a sample through gsm_postprocess_s8() */
+  HAL_WORK_LZ77_BYTE,   /* a byte out of lz77_vram_step() */
+  HAL_WORK_BAR_PIXEL,   /* a pixel of the progress bar */
+  HAL_WORK_MAIN_LOOP,   /* the rest of one pass of streaming_run() */
+  HAL_N_WORK
+};
+
+#define HAL_INT_VBLANK  0x0001
+#define HAL_INT_TIMER1  0x0010
+#define HAL_INT_JOY     0x1000
+
+void isr(void);
+
+#ifdef HAL_HOST
+
+extern u16 hal_vram[0xc000];
+extern u16 hal_palram[0x200];
+extern volatile u16 hal_bgctrl[4];
+extern volatile u16 hal_lcdmode, hal_intenable;
+unsigned int hal_lcd_y(void);
+
+#undef VRAM
+#define VRAM hal_vram
+#undef PALRAM
+#define PALRAM hal_palram
+#undef MAP
+#define MAP ((NAMETABLE *)hal_vram)
+#undef BGCTRL
+#define BGCTRL hal_bgctrl
+#undef LCDMODE
+#define LCDMODE hal_lcdmode
+#undef LCD_Y
+#define LCD_Y hal_lcd_y()
+#undef INTENABLE
+#define INTENABLE hal_intenable
+
+void hal_init(void);
+const GBFS_FILE *hal_find_gbfs(void);
+void hal_sound_init(void);
+void hal_sound_start(unsigned int seg_len, unsigned int period);
+void hal_sound_stop(void);
+void hal_fifo_start(const void *src);
+void hal_wait_vblank(void);
+void hal_wait_keys(unsigned int irqs);
+u32 hal_cycles(void);
+#define hal_ticks() (hal_cycles() >> 6)
+unsigned int hal_keys(void);
+unsigned int hal_irq_ack(void);
+void hal_dma_copy32(void *dst, const void *src, u32 words);
+void hal_work(unsigned int kind, u32 units);
+void hal_sram_read(u32 offset, void *dst, u32 len);
+void hal_sram_write(u32 offset, const void *src, u32 len);
+void hal_debug_log(const char *s);
+void hal_fatal(u16 color);
+
+#else
+
+#define HAL_INTACK      (*(volatile u16 *)0x04000202)
+#define HAL_BIOS_INTACK (*(volatile u16 *)0x03007ff8)
+#define HAL_SRAM        ((volatile u8 *)0x0e000000)
+
+/* mGBA's debug log; other emulators and the GBA ignore it */
+#define HAL_MGBA_STRING ((volatile char *)0x04fff600)
+#define HAL_MGBA_FLAGS  (*(volatile u16 *)0x04fff700)
+#define HAL_MGBA_ENABLE (*(volatile u16 *)0x04fff780)
+#define HAL_MGBA_INFO   0x0103
+
+/* hal_init() **************
+   Starts TIMER[2] and TIMER[3] counting cycles for hal_cycles() and
+   turns on the vblank and TIMER[1] IRQs.
+*/
+static inline void hal_init(void)
+{
+  TIMER[3].count = 0;
+  TIMER[3].control = TIMER_CASCADE | TIMER_ENABLE;
+  TIMER[2].count = 0;
+  TIMER[2].control = TIMER_16MHZ | TIMER_ENABLE;
+
+  SET_MASTER_ISR(isr);
+  LCDSTAT = LCDSTAT_VBLIRQ;            /* one plug to the display */
+  INTMASK = INT_VBLANK | INT_TIMER(1); /* the other to the isr */
+  INTENABLE = 1;                       /* and flip the switch */
+}
+
+/* hal_find_gbfs() **************
+   Returns the GBFS file appended to the ROM, or NULL.
+*/
+static inline const GBFS_FILE *hal_find_gbfs(void)
+{
+  const GBFS_FILE *fs = find_header_gbfs_file();
+
+  if(!fs)
+    fs = find_first_gbfs_file(find_first_gbfs_file);
+  return fs;
+}
+
+/* hal_sound_init() **************
+   Stops the sample clock and turns on direct sound A, fed by
+   TIMER[0], at full volume on both sides.
+*/
+static inline void hal_sound_init(void)
+{
+  TIMER[0].control = 0;
+  TIMER[1].control = 0;
+  SETSNDRES(1);
+  SNDSTAT = SNDSTAT_ENABLE;
+  DSOUNDCTRL = 0x0b0e;
+}
+
+/* hal_sound_start() **************
+   Starts TIMER[0] clocking a sample into the DAC every period
+   cycles, and TIMER[1] raising an IRQ every seg_len samples.
+*/
+static inline void hal_sound_start(unsigned int seg_len,
+                                   unsigned int period)
+{
+  TIMER[1].count = 0x10000 - seg_len;
+  TIMER[1].control = TIMER_CASCADE | TIMER_IRQ | TIMER_ENABLE;
+  TIMER[0].count = 0x10000 - period;
+  TIMER[0].control = TIMER_16MHZ | TIMER_ENABLE;
+}
+
+/* hal_sound_stop() **************
+   Stops the sample clock and DMA1.  The DAC holds the last sample,
+   and a TIMER[1] IRQ that came due with INTENABLE off is dropped.
+*/
+static inline void hal_sound_stop(void)
+{
+  TIMER[0].control = 0;
+  TIMER[1].control = 0;
+  DMA[1].control = 0;
+  HAL_INTACK = INT_TIMER(1);
+}
+
+/* hal_fifo_start() **************
+   Points DMA1 at src, from where it keeps FIFO A fed.
+*/
+static inline void hal_fifo_start(const void *src)
+{
+  DMA[1].control = 0;
+
+  /* no-op to let DMA registers catch up */
+  asm volatile("eor r0, r0; eor r0, r0" ::: "r0");
+
+  DMA[1].src = src;
+  DMA[1].dst = (void *)0x040000a0; /* write to FIFO A address */
+  DMA[1].count = 1;
+  DMA[1].control = DMA_DSTUNCH | DMA_SRCINC | DMA_REPEAT | DMA_U32 |
+                   DMA_SPECIAL | DMA_ENABLE;
+}
+
+/* hal_wait_vblank() **************
+   Halts until the next vblank IRQ.
+*/
+static inline void hal_wait_vblank(void)
+{
+  asm volatile("mov r2, #0; swi 0x05" ::: "r0", "r1", "r2", "r3");
+}
+
+/* hal_wait_keys() **************
+   Halts with only the keypad IRQ and irqs, such as HAL_INT_TIMER1,
+   on until a key is pressed or isr() has handled one of irqs, then
+   turns the vblank and TIMER[1] IRQs back on.  Call with no keys
+   held, or it returns at once.
+*/
+static inline void hal_wait_keys(unsigned int irqs)
+{
+  register unsigned int r0 asm("r0") = 1;
+  register unsigned int r1 asm("r1") = INT_JOY | irqs;
+
+  JOYIRQ = JOYIRQ_ANY | 0x03ff;
+  INTMASK = INT_JOY | irqs;
+  asm volatile("swi 0x04" : "+r"(r0), "+r"(r1) :: "r2", "r3");
+  JOYIRQ = 0;
+  INTMASK = INT_VBLANK | INT_TIMER(1);
+}
+
+/* hal_cycles() **************
+   Reads TIMER[3]:TIMER[2] as one 32-bit count of cycles.  It wraps
+   every 256 seconds.
+*/
+static inline u32 hal_cycles(void)
+{
+  unsigned int hi, lo;
+
+  do
+  {
+    hi = TIMER[3].count;
+    lo = TIMER[2].count;
+  } while(hi != TIMER[3].count);
+  return (hi << 16) | lo;
+}
+
+#define hal_ticks() (hal_cycles() >> 6)
+
+/* hal_keys() **************
+   Returns the keys held down, 1 for pressed.
+*/
+static inline unsigned int hal_keys(void)
+{
+  return (JOY & 0x3ff) ^ 0x3ff;
+}
+
+/* hal_irq_ack() **************
+   Acknowledges the pending interrupts, to the hardware and to the
+   BIOS's IntrWait, and returns them.
+*/
+static inline unsigned int hal_irq_ack(void)
+{
+  unsigned int interrupts = HAL_INTACK;
+
+  HAL_BIOS_INTACK |= interrupts;
+  HAL_INTACK = interrupts;
+  return interrupts;
+}
+
+/* hal_dma_copy32() **************
+   Copies words 32-bit words with DMA3.  The CPU stops until it is
+   done, but higher priority DMA such as the sound still gets
+   through.
+*/
+static inline void hal_dma_copy32(void *dst, const void *src, u32 words)
+{
+  DMA[3].src = src;
+  DMA[3].dst = dst;
+  DMA[3].count = words;
+  DMA[3].control = DMA_SRCINC | DMA_DSTINC | DMA_U32 | DMA_COPYNOW;
+}
+
+#define hal_work(kind, units) ((void)0)
+
+/* hal_sram_read() **************
+   Copies len bytes from battery SRAM at offset, a byte at a time as
+   its 8-bit bus needs.
+*/
+static inline void hal_sram_read(u32 offset, void *dst, u32 len)
+{
+  u8 *d = dst;
+  const volatile u8 *src = HAL_SRAM + offset;
+
+  for(; len > 0; len--)
+    *d++ = *src++;
+}
+
+/* hal_sram_write() **************
+   Copies len bytes to battery SRAM at offset.
+*/
+static inline void hal_sram_write(u32 offset, const void *src, u32 len)
+{
+  const u8 *s = src;
+  volatile u8 *dst = HAL_SRAM + offset;
+
+  for(; len > 0; len--)
+    *dst++ = *s++;
+}
+
+/* hal_debug_log() **************
+   Sends a line of up to 255 characters to the emulator's log.
+*/
+static inline void hal_debug_log(const char *s)
+{
+  unsigned int i;
+
+  HAL_MGBA_ENABLE = 0xc0de;
+  if(HAL_MGBA_ENABLE != 0x1dea)
+    return;
+  for(i = 0; i < 255 && s[i]; i++)
+    HAL_MGBA_STRING[i] = s[i];
+  HAL_MGBA_STRING[i] = 0;
+  HAL_MGBA_FLAGS = HAL_MGBA_INFO;
+}
+
+/* hal_fatal() **************
+   Fills the screen with color and stops.
+*/
+static inline void hal_fatal(u16 color)
+{
+  LCDMODE = 0;
+  PALRAM[0] = color;
+  while(1) {}
+}
+
+#endif
+#endif
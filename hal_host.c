@@ -0,0 +1,667 @@
+/* hal_host.c
+   runs the GSM player on a PC against a simulated GBA clock
+*/
+
+/*
+ * Copyright 2026 GBAWAVE contributors.
+ * See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+ * THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+ */
+
+/* This is the HAL_HOST half of hal.h.  Linked with gsmplay.c, hud.c,
+   isr.c, lz77.c, libgbfs.c, and gsmcode.c built for the PC (make
+   gsmsim.exe), it plays a GBFS file through streaming_run() and
+   reports how well the ring kept up:
+
+     gsmsim [-n frames] [-k keyfile] [-o out.raw] [-c frames.csv]
+            [-s out.sav] [-w kind=cycles] [-p cycles] gsmsongs.gbfs
+
+   Nothing here looks at the PC's own clock, so the same arguments
+   always give the same report.  One count of GBA cycles drives
+   everything:
+     - Every seg_len * period cycles after hal_sound_start(), DMA1
+       has moved another segment into FIFO A.  Those bytes go to the
+       -o file as signed 8-bit mono at 36314 Hz, and the TIMER[1]
+       IRQ goes pending.
+     - Line 160 of each 280896-cycle video frame raises vblank.
+     - A pending IRQ runs isr() once INTENABLE is on, unless the CPU
+       is already in isr() outside irq_call_nested() or is stopped
+       for a DMA3 copy.  Two overflows of TIMER[1] before isr() gets
+       to run count once, as on the hardware.
+     - Cycles pass only when the player waits for vblank or a key
+       or does work that hal_work() or hal_dma_copy32() charges for.
+     - Keys change only at vblank, so hal_wait_keys() wakes there.
+     - The report gives the longest time from the end of the ring's
+       last segment to the hal_fifo_start() that sends DMA1 back to
+       the top, and how many bytes DMA1 read past the ring meanwhile.
+       Those have to fit in gsmplay.c's DSOUND_FIFO_SLACK.  A
+       segment lasts exactly one video frame, so where its end falls
+       against vblank never moves; -p delays the sample clock by that
+       many cycles to try other places.
+
+   The cycles charged for each kind of work are estimates from the
+   counts in gsmcode.c and hud.c, not measurements; change them with
+   -w frame=, sample=, lz77=, bar=, and main=.
+
+   hal_debug_log() lines go to standard output.  -s keeps battery
+   SRAM in a file, as an emulator does with a .sav file.
+
+   A key file has lines of "FRAME KEYS", meaning from video frame
+   FRAME on, hold KEYS: names from A B SELECT START RIGHT LEFT UP
+   DOWN R L joined with +, or - for none.  # starts a comment.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+
+#define CYCLES_PER_LINE 1232
+#define CYCLES_PER_FRAME (CYCLES_PER_LINE * 228)
+#define VBLANK_LINE 160
+#define DMA_BYTE_CYCLES 2       /* hud.c: 2048 bytes in about 4,000 */
+#define MAX_QUEUED 8            /* histogram buckets */
+
+typedef unsigned long long cycles_t;
+
+u16 hal_vram[0xc000];
+u16 hal_palram[0x200];
+volatile u16 hal_bgctrl[4];
+volatile u16 hal_lcdmode, hal_intenable;
+
+/* what chr.s and asm.s give hud.c on the GBA */
+const char _8x16_fnt[1];
+const unsigned int _8x16_fnt_len = 0;
+
+u32 fracumul(u32 x, u32 frac)
+{
+  return ((cycles_t)x * frac) >> 32;
+}
+
+s32 dv(s32 num, s32 den)
+{
+  return num / den;
+}
+
+int player_main(void);
+extern volatile unsigned int dsound_played, dsound_filled;
+extern volatile unsigned int dsound_underruns;
+
+static const char help_text[] =
+"Runs the GSM player's streaming loop against a simulated GBA.\n"
+"usage: gsmsim [options] GBFSFILE\n"
+"  -n FRAMES      video frames to run (default 600)\n"
+"  -k KEYFILE     joypad script: lines of \"FRAME KEYS\"\n"
+"  -o RAWFILE     write the sound as 8-bit signed mono at 36314 Hz\n"
+"  -c CSVFILE     write cycles and fewest queued segments per frame\n"
+"  -s SAVFILE     battery SRAM: loaded if it exists, saved at the end\n"
+"  -w KIND=CYCLES change the cost of frame, sample, lz77, bar, or main\n"
+"  -p CYCLES      start the sample clock CYCLES later than the player asks\n";
+
+static const char *const work_names[HAL_N_WORK] =
+{
+  "frame", "sample", "lz77", "bar", "main"
+};
+
+/* cycles for one unit of each kind of work */
+static u32 work_cycles[HAL_N_WORK] =
+{
+  44000,  /* gsm_decode_raw_n(), per frame */
+  30,     /* gsm_postprocess_s8(), per input sample */
+  10,     /* lz77_vram_step(), per byte */
+  16,     /* hud_bar(), per pixel; a whole bar is 1160 */
+  2000    /* the rest of streaming_run() */
+};
+
+static cycles_t now;        /* since power on */
+static cycles_t ticks_base; /* when hal_init() started TIMER[2] */
+static u8 sram[0x8000];
+static const char *sram_filename;
+static cycles_t next_vblank = VBLANK_LINE * CYCLES_PER_LINE;
+static cycles_t next_seg;   /* 0 while the sample clock is off */
+static cycles_t seg_cycles;
+static unsigned int seg_len;
+static const signed char *fifo_src;
+static cycles_t seg_ended;  /* when the last segment ran out */
+static cycles_t clock_phase;  /* -p */
+
+static unsigned int irq_pending, bios_intack;
+static unsigned int irq_mask = HAL_INT_VBLANK | HAL_INT_TIMER1;
+static int in_isr;          /* in isr() with IRQs off */
+static int irq_depth;       /* isr() calls under way */
+static int dma_busy;
+
+static const GBFS_FILE *gbfs;
+
+/* the joypad script */
+struct KEY_EVENT
+{
+  unsigned long frame;
+  unsigned int keys;
+};
+static struct KEY_EVENT *key_events;
+static unsigned int n_key_events;
+
+/* statistics */
+static unsigned long frames, max_frames = 600;
+static unsigned long segs_played;
+static cycles_t frame_main, frame_irq, frame_idle;
+static unsigned int frame_queued = ~0U;  /* ~0U if no segment ended */
+static cycles_t sum[3], lo[3], hi[3];
+static cycles_t busy[2], total[2];  /* frames with the clock on, off */
+static unsigned long queued_hist[MAX_QUEUED + 1];
+static cycles_t fifo_late;  /* worst hal_fifo_start() after a segment */
+static FILE *raw_out, *csv_out;
+
+static void report(void);
+
+/* charge() **************
+   Counts cycles that just passed against the main loop or the IRQ,
+   whichever the CPU is in.
+*/
+static void charge(cycles_t cycles)
+{
+  if(irq_depth)
+    frame_irq += cycles;
+  else
+    frame_main += cycles;
+}
+
+/* end_frame() **************
+   Closes the statistics for the video frame ending at this vblank.
+*/
+static void end_frame(void)
+{
+  cycles_t c[3];
+  unsigned int queued = frame_queued;
+  unsigned int i;
+
+  c[0] = frame_main;
+  c[1] = frame_irq;
+  c[2] = frame_idle;
+  for(i = 0; i < 3; i++)
+  {
+    sum[i] += c[i];
+    if(frames == 0 || c[i] < lo[i])
+      lo[i] = c[i];
+    if(c[i] > hi[i])
+      hi[i] = c[i];
+  }
+  i = next_seg == 0;
+  busy[i] += c[0] + c[1];
+  total[i] += c[0] + c[1] + c[2];
+  if(queued != ~0U)
+    queued_hist[queued < MAX_QUEUED ? queued : MAX_QUEUED]++;
+  if(csv_out)
+    fprintf(csv_out, "%lu,%llu,%llu,%llu,%d,%u\n",
+            frames, c[0], c[1], c[2], (int)queued, dsound_underruns);
+  frame_main = frame_irq = frame_idle = 0;
+  frame_queued = ~0U;
+
+  if(++frames >= max_frames)
+  {
+    report();
+    exit(0);
+  }
+}
+
+/* run_events() **************
+   Does whatever the hardware has due at the current cycle.
+*/
+static void run_events(void)
+{
+  if(next_seg && now >= next_seg)
+  {
+    /* segments decoded past the one that just ended */
+    int queued = (int)(dsound_filled - dsound_played) - 1;
+
+    if(queued < 0)
+      queued = 0;
+    if((unsigned int)queued < frame_queued)
+      frame_queued = queued;
+    if(raw_out)
+      fwrite(fifo_src, 1, seg_len, raw_out);
+    fifo_src += seg_len;
+    segs_played++;
+    irq_pending |= HAL_INT_TIMER1;
+    seg_ended = next_seg;
+    next_seg += seg_cycles;
+  }
+  if(now >= next_vblank)
+  {
+    irq_pending |= HAL_INT_VBLANK;
+    next_vblank += CYCLES_PER_FRAME;
+    end_frame();
+  }
+}
+
+static cycles_t next_event(void)
+{
+  if(next_seg && next_seg < next_vblank)
+    return next_seg;
+  return next_vblank;
+}
+
+/* take_irqs() **************
+   Runs isr() for pending IRQs if the CPU would take them now.
+*/
+static void take_irqs(void)
+{
+  while((irq_pending & irq_mask) && hal_intenable && !in_isr && !dma_busy)
+  {
+    in_isr = 1;
+    irq_depth++;
+    isr();
+    irq_depth--;
+    in_isr = 0;
+  }
+}
+
+/* spend() **************
+   Lets cycles of CPU time pass in the code that is running, with
+   IRQs cutting in as they come due.
+*/
+static void spend(cycles_t cycles)
+{
+  take_irqs();
+  for(;;)
+  {
+    cycles_t ev = next_event();
+
+    if(now + cycles < ev)
+    {
+      charge(cycles);
+      now += cycles;
+      return;
+    }
+    charge(ev - now);
+    cycles -= ev - now;
+    now = ev;
+    run_events();
+    take_irqs();
+  }
+}
+
+void irq_call_nested(void (*fn)(void))
+{
+  in_isr = 0;
+  fn();
+  in_isr = 1;
+}
+
+void hal_init(void)
+{
+  ticks_base = now;
+  hal_intenable = 1;
+}
+
+const GBFS_FILE *hal_find_gbfs(void)
+{
+  return gbfs;
+}
+
+void hal_sound_init(void)
+{
+  next_seg = 0;
+}
+
+void hal_sound_start(unsigned int len, unsigned int period)
+{
+  seg_len = len;
+  seg_cycles = (cycles_t)len * period;
+  next_seg = now + seg_cycles + clock_phase;
+}
+
+void hal_sound_stop(void)
+{
+  next_seg = 0;
+  irq_pending &= ~HAL_INT_TIMER1;
+}
+
+void hal_fifo_start(const void *src)
+{
+  /* DMA1 has been reading past the ring since the segment ended */
+  if(next_seg && segs_played && now - seg_ended > fifo_late)
+    fifo_late = now - seg_ended;
+  fifo_src = src;
+}
+
+/* hal_wait_vblank() **************
+   Idles until isr() has acknowledged a new vblank, like the BIOS's
+   VBlankIntrWait.
+*/
+void hal_wait_vblank(void)
+{
+  bios_intack &= ~HAL_INT_VBLANK;
+  take_irqs();
+  while(!(bios_intack & HAL_INT_VBLANK))
+  {
+    cycles_t ev = next_event();
+
+    frame_idle += ev - now;
+    now = ev;
+    run_events();
+    take_irqs();
+  }
+}
+
+/* hal_wait_keys() **************
+   Idles with only the keypad IRQ and irqs on until a key is held or
+   isr() has acknowledged one of irqs.  Other IRQs stay pending until
+   it returns, as they do in IF on the hardware.
+*/
+void hal_wait_keys(unsigned int irqs)
+{
+  irq_mask = HAL_INT_JOY | irqs;
+  bios_intack &= ~irqs;
+  take_irqs();
+  while(!hal_keys() && !(bios_intack & irqs))
+  {
+    cycles_t ev = next_event();
+
+    frame_idle += ev - now;
+    now = ev;
+    run_events();
+    take_irqs();
+  }
+  irq_mask = HAL_INT_VBLANK | HAL_INT_TIMER1;
+}
+
+u32 hal_cycles(void)
+{
+  return now - ticks_base;
+}
+
+unsigned int hal_keys(void)
+{
+  unsigned int keys = 0;
+  unsigned int i;
+
+  for(i = 0; i < n_key_events && key_events[i].frame <= frames; i++)
+    keys = key_events[i].keys;
+  return keys;
+}
+
+unsigned int hal_lcd_y(void)
+{
+  return (now / CYCLES_PER_LINE) % 228;
+}
+
+unsigned int hal_irq_ack(void)
+{
+  unsigned int interrupts = irq_pending;
+
+  irq_pending = 0;
+  bios_intack |= interrupts;
+  return interrupts;
+}
+
+void hal_dma_copy32(void *dst, const void *src, u32 words)
+{
+  memcpy(dst, src, words * 4);
+  take_irqs();
+  dma_busy = 1;
+  spend((cycles_t)words * 4 * DMA_BYTE_CYCLES);
+  dma_busy = 0;
+}
+
+void hal_work(unsigned int kind, u32 units)
+{
+  spend((cycles_t)units * work_cycles[kind]);
+}
+
+void hal_sram_read(u32 offset, void *dst, u32 len)
+{
+  if(offset < sizeof(sram) && len <= sizeof(sram) - offset)
+    memcpy(dst, sram + offset, len);
+}
+
+void hal_sram_write(u32 offset, const void *src, u32 len)
+{
+  if(offset < sizeof(sram) && len <= sizeof(sram) - offset)
+    memcpy(sram + offset, src, len);
+}
+
+void hal_debug_log(const char *s)
+{
+  printf("log: %.255s\n", s);
+}
+
+void hal_fatal(u16 color)
+{
+  fprintf(stderr, "gsmsim: player stopped on color $%04x\n", color);
+  report();
+  exit(1);
+}
+
+/* report() **************
+   Prints the statistics so far.
+*/
+static void report(void)
+{
+  static const char *const rows[3] = {"main", "irq", "idle"};
+  unsigned int i;
+
+  if(sram_filename)
+  {
+    FILE *fp = fopen(sram_filename, "wb");
+
+    if(!fp || fwrite(sram, 1, sizeof(sram), fp) != sizeof(sram))
+      perror(sram_filename);
+    if(fp)
+      fclose(fp);
+  }
+
+  printf("frames: %lu (%.1f s)\n",
+         frames, frames * (double)CYCLES_PER_FRAME / 16777216);
+  printf("segments played: %lu\n", segs_played);
+  printf("underruns: %u\n", dsound_underruns);
+  if(seg_len)
+    printf("slowest DMA1 restart: %llu cycles, %llu bytes past the ring\n",
+           fifo_late, fifo_late * seg_len / seg_cycles);
+  printf("fewest segments queued in a frame:");
+  for(i = 0; i <= MAX_QUEUED; i++)
+    if(queued_hist[i])
+      printf(" %u:%lu", i, queued_hist[i]);
+  printf("\ncycles per frame     min     avg     max\n");
+  for(i = 0; i < 3 && frames > 0; i++)
+    printf("%-8s      %7llu %7llu %7llu\n",
+           rows[i], lo[i], sum[i] / frames, hi[i]);
+  if(frames > 0)
+    printf("cpu busy: %.1f%%\n",
+           100.0 * (sum[0] + sum[1]) / (sum[0] + sum[1] + sum[2]));
+  for(i = 0; i < 2; i++)
+    if(total[i])
+      printf("  with the sample clock %s: %.2f%%\n",
+             i ? "stopped" : "running", 100.0 * busy[i] / total[i]);
+}
+
+/* parse_keys() **************
+   Converts "A+START" and the like to a hal_keys() mask.  Returns -1
+   for a name it doesn't know.
+*/
+static int parse_keys(const char *s)
+{
+  static const char *const names[10] =
+  {
+    "A", "B", "SELECT", "START", "RIGHT", "LEFT", "UP", "DOWN", "R", "L"
+  };
+  int keys = 0;
+
+  if(!strcmp(s, "-"))
+    return 0;
+  while(*s)
+  {
+    size_t len = strcspn(s, "+");
+    unsigned int i;
+
+    for(i = 0; i < 10; i++)
+      if(strlen(names[i]) == len && !strncmp(s, names[i], len))
+        break;
+    if(i >= 10)
+      return -1;
+    keys |= 1 << i;
+    s += len;
+    if(*s)
+      s++;
+  }
+  return keys;
+}
+
+static int load_keys(const char *filename)
+{
+  FILE *fp = fopen(filename, "r");
+  char line[256];
+  unsigned int line_no = 0;
+
+  if(!fp)
+  {
+    perror(filename);
+    return 0;
+  }
+  while(fgets(line, sizeof(line), fp))
+  {
+    char keys[200];
+    unsigned long frame;
+    int mask;
+
+    line_no++;
+    if(line[strspn(line, " \t\r\n")] == '#'
+       || line[strspn(line, " \t\r\n")] == 0)
+      continue;
+    if(sscanf(line, "%lu %199s", &frame, keys) != 2
+       || (mask = parse_keys(keys)) < 0
+       || (n_key_events && frame < key_events[n_key_events - 1].frame))
+    {
+      fprintf(stderr, "%s:%u: bad key line\n", filename, line_no);
+      fclose(fp);
+      return 0;
+    }
+    key_events = realloc(key_events,
+                         (n_key_events + 1) * sizeof(struct KEY_EVENT));
+    if(!key_events)
+    {
+      fclose(fp);
+      return 0;
+    }
+    key_events[n_key_events].frame = frame;
+    key_events[n_key_events].keys = mask;
+    n_key_events++;
+  }
+  fclose(fp);
+  return 1;
+}
+
+static const GBFS_FILE *load_gbfs(const char *filename)
+{
+  FILE *fp = fopen(filename, "rb");
+  char *buf;
+  long len;
+
+  if(!fp)
+  {
+    perror(filename);
+    return NULL;
+  }
+  fseek(fp, 0, SEEK_END);
+  len = ftell(fp);
+  rewind(fp);
+  buf = malloc(len > 0 ? len : 1);
+  if(!buf || len < (long)sizeof(GBFS_FILE)
+     || fread(buf, 1, len, fp) != (size_t)len
+     || memcmp(buf, "PinEightGBFS", 12))
+  {
+    fprintf(stderr, "%s: not a GBFS file\n", filename);
+    fclose(fp);
+    free(buf);
+    return NULL;
+  }
+  fclose(fp);
+  return (const GBFS_FILE *)buf;
+}
+
+int main(int argc, char **argv)
+{
+  int i;
+
+  for(i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2)
+  {
+    const char *arg = argv[i + 1];
+
+    switch(argv[i][1])
+    {
+    case 'n':
+      max_frames = strtoul(arg, NULL, 10);
+      break;
+    case 'k':
+      if(!load_keys(arg))
+        return 1;
+      break;
+    case 'o':
+      raw_out = fopen(arg, "wb");
+      if(!raw_out)
+      {
+        perror(arg);
+        return 1;
+      }
+      break;
+    case 'c':
+      csv_out = fopen(arg, "w");
+      if(!csv_out)
+      {
+        perror(arg);
+        return 1;
+      }
+      fputs("frame,main,irq,idle,queued,underruns\n", csv_out);
+      break;
+    case 's':
+      sram_filename = arg;
+      break;
+    case 'p':
+      clock_phase = strtoul(arg, NULL, 10);
+      break;
+    case 'w':
+      {
+        size_t len = strcspn(arg, "=");
+        unsigned int kind;
+
+        for(kind = 0; kind < HAL_N_WORK; kind++)
+          if(strlen(work_names[kind]) == len
+             && !strncmp(arg, work_names[kind], len))
+            break;
+        if(kind >= HAL_N_WORK || !arg[len])
+        {
+          fputs(help_text, stderr);
+          return 1;
+        }
+        work_cycles[kind] = strtoul(arg + len + 1, NULL, 10);
+      }
+      break;
+    default:
+      fputs(help_text, stderr);
+      return 1;
+    }
+  }
+  if(i != argc - 1 || max_frames == 0)
+  {
+    fputs(help_text, stderr);
+    return 1;
+  }
+  memset(sram, 0xff, sizeof(sram));
+  if(sram_filename)
+  {
+    FILE *fp = fopen(sram_filename, "rb");
+
+    if(fp)
+    {
+      fread(sram, 1, sizeof(sram), fp);
+      fclose(fp);
+    }
+  }
+  gbfs = load_gbfs(argv[i]);
+  if(!gbfs)
+    return 1;
+
+  player_main();
+  return 0;
+}
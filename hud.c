@@ -1,12 +1,16 @@
 #include <stdlib.h>
+#include <string.h>
 #include "pin8gba.h"
 #include "gbfs.h"
+#include "hal.h"
 
 extern const char _8x16_fnt[];
 extern const unsigned int _8x16_fnt_len;
 
 extern u32 fracumul(u32, u32) __attribute__((long_call));
 extern s32 dv(s32, s32) __attribute__((long_call));
+extern u32 lz77_vram_start(const void *, void *) __attribute__((long_call));
+extern u32 lz77_vram_step(u32) __attribute__((long_call));
 
 /* upcvt_4bit() ************************
    Converts a 1-bit font to GBA 4-bit format.
@@ -170,13 +174,221 @@ void hud_frame(int locked, unsigned int t)
   hud_clock.trackno[0] = trackno - upper * 10;
 }*/
 
-void hud_new_song(const char *name, GBFS_FILE *fs){
-	char imgName[strlen(name)+6];
-	strcpy(imgName, "img");
-	strcat(imgName, name);
-	//while(LCD_Y >= 160);
-	//while(LCD_Y < 160);
-	gbfs_copy_obj(0x6000000, fs, imgName);
+/* A cover is a 240x160 bitmap.  Copying it in one go holds up the
+   main loop for over half a frame and tears across the screen, so
+   hud_new_song() only notes where the cover is and hud_cover_step()
+   moves it to VRAM a slice at a time.
+
+   tools/gbfs stores the cover of song under one of four names:
+     imgsong  mode 3 RGB15 bitmap, 76800 bytes
+     imzsong  the same, LZ77 compressed for the BIOS
+     palsong  mode 4: 256-entry palette, then 38400 bytes of pixels
+     pazsong  the same with the pixels LZ77 compressed
+   A raw slice is one DMA3 burst of COVER_DMA_SLICE bytes.  A
+   compressed slice goes through lz77.c and produces COVER_LZ_SLICE
+   bytes.
+
+   The CPU, and with it the TIMER1 IRQ, stops for a whole DMA3
+   burst.  If a segment ends meanwhile, DMA1 reads on past it into
+   the ring's DSOUND_FIFO_SLACK until the IRQ can restart it.  The 32
+   bytes of slack last about 14,800 cycles at 36314 Hz, so a burst
+   has to be well short of that.
+
+   A mode 4 cover goes into the page that isn't showing, and
+   hud_cover_flip() shows it with its palette in one vblank, so the
+   old cover stays up until the new one is complete.  A mode 3 cover
+   fills the only page there is as it comes in.  When the mode has
+   to change, the screen is blanked until hud_cover_flip() shows the
+   new cover. */
+#define COVER_DMA_SLICE 2048  /* about 4,000 cycles */
+#define COVER_LZ_SLICE 2048
+#define COVER_PAGE_LEN 0xA000
+#define COVER_BAR_PAL 254     /* entries for the progress bar */
+static const u32 *cover_src;
+static u32 *cover_dst;
+static u32 cover_left;  /* bytes */
+static int cover_packed;
+static const u16 *cover_pal;  /* NULL for a mode 3 cover */
+static u16 cover_lcdmode;     /* LCDMODE once the cover is in */
+static int cover_show;        /* in but not yet shown */
+static u16 hud_blank_bit;     /* LCDMODE_BLANK while the screen is off */
+static u16 cover_blank_bit;   /* LCDMODE_BLANK until a new mode's cover is in */
+
+/* hud_bar() draws only what the bar has grown by since the last call,
+   on the same page in the same color.  Anything that writes over it
+   sets bar_page to NULL so that the next call draws all of it. */
+static u16 *bar_page;
+static int bar_right, bar_alert;
+
+/* the kinds of cover, in the order hud_find_cover() prefers them;
+   0 is no cover */
+static const char cover_prefixes[][4] =
+{
+  "paz", "pal", "imz", "img"
+};
+#define COVER_N_KINDS 4
+#define COVER_KIND_IS_PACKED(kind) ((kind) == 1 || (kind) == 3)
+#define COVER_KIND_IS_PAL(kind) ((kind) <= 2)
+
+/* hud_cover_of() ********************
+   If name is a cover's name, returns the name of the song it goes
+   with, otherwise NULL.
+*/
+const char *hud_cover_of(const char *name)
+{
+  unsigned int kind;
+
+  for(kind = 0; kind < COVER_N_KINDS; kind++)
+    if(!strncmp(name, cover_prefixes[kind], 3))
+      return name + 3;
+  return NULL;
+}
+
+/* hud_find_cover() ********************
+   Looks up the cover of the song called name.  Returns its kind, or
+   0 if it has none, and sets *cover and *len.  The track table keeps
+   these for hud_new_song().
+*/
+unsigned int hud_find_cover(const char *name, const GBFS_FILE *fs,
+                            const void **cover, u32 *len)
+{
+  char imgName[strlen(name)+4];
+  unsigned int kind;
+
+  for(kind = 0; kind < COVER_N_KINDS; kind++)
+  {
+    strcpy(imgName, cover_prefixes[kind]);
+    strcat(imgName, name);
+    *cover = gbfs_get_obj(fs, imgName, len);
+    if(*cover)
+      return kind + 1;
+  }
+  *len = 0;
+  return 0;
+}
+
+/* hud_new_song() ********************
+   Starts loading a cover that hud_find_cover() found and returns how
+   many bytes of it hud_cover_step() has to place.
+*/
+u32 hud_new_song(const void *cover, u32 len, unsigned int kind){
+	const u8 *obj = cover;
+	u32 max_len;
+	unsigned int mode = LCDMODE & 7;
+
+	cover_left = 0;
+	cover_show = 0;
+	if(kind == 0)
+		return 0;
+	cover_packed = COVER_KIND_IS_PACKED(kind);
+	if(COVER_KIND_IS_PAL(kind))
+	{
+		unsigned int back = (mode == 4) && !(LCDMODE & LCDMODE_PAGE(1));
+
+		if(len <= 512)
+			return 0;
+		cover_pal = (const u16 *)obj;
+		cover_src = (const u32 *)(obj + 512);
+		cover_dst = (u32 *)(VRAM + back * (COVER_PAGE_LEN / 2));
+		cover_lcdmode = 4 | LCDMODE_BG2 | LCDMODE_PAGE(back);
+		max_len = 240*160;
+		len -= 512;
+	}
+	else
+	{
+		cover_pal = NULL;
+		cover_src = (const u32 *)obj;
+		cover_dst = (u32 *)VRAM;
+		cover_lcdmode = 3 | LCDMODE_BG2;
+		max_len = 240*160*2;
+	}
+
+	if(cover_packed)
+	{
+		len = lz77_vram_start(cover_src, cover_dst);
+		if(len > max_len)
+			return 0;
+	}
+	else if(len > max_len)
+		len = max_len;
+	cover_left = len & ~3;
+
+	/* a new mode shows garbage until the cover is in */
+	if(cover_left && mode != (cover_lcdmode & 7))
+	{
+		PALRAM[0] = RGB(0, 0, 0);
+		cover_blank_bit = LCDMODE_BLANK;
+		LCDMODE = (cover_lcdmode & 7) | LCDMODE_BLANK;
+		bar_page = NULL;
+	}
+	return cover_left;
+}
+
+/* hud_cover_step() ********************
+   Places one more slice of the cover and returns how many bytes are
+   left.  For a raw cover the CPU stops while DMA3 runs.  DMA1 still
+   feeds the sound FIFO, but it can't be restarted at a segment
+   boundary until the slice is done.
+*/
+u32 hud_cover_step(void)
+{
+  u32 len = cover_left < COVER_DMA_SLICE ? cover_left : COVER_DMA_SLICE;
+
+  if(cover_packed)
+  {
+    if(cover_left)
+    {
+      u32 left = lz77_vram_step(COVER_LZ_SLICE);
+
+      hal_work(HAL_WORK_LZ77_BYTE, cover_left - left);
+      cover_left = left;
+    }
+  }
+  else if(len)
+  {
+    hal_dma_copy32(cover_dst, cover_src, len >> 2);
+    cover_src += len >> 2;
+    cover_dst += len >> 2;
+    cover_left -= len;
+  }
+  if(len)
+    bar_page = NULL;
+  if(len && !cover_left)
+    cover_show = 1;
+  return cover_left;
+}
+
+/* hud_cover_flip() ********************
+   Shows a cover that has finished loading, with its palette if it
+   has one, and ends the blank from a change of mode.  Call it right
+   after vblank.  If vblank is already over it does nothing, and the
+   cover stays pending for the next call, unless the screen is off.
+*/
+void hud_cover_flip(void)
+{
+  if(!cover_show || (LCD_Y < 160 && !hud_blank_bit))
+    return;
+  if(cover_pal)
+  {
+    hal_dma_copy32(PALRAM, cover_pal, COVER_BAR_PAL / 2);
+    PALRAM[COVER_BAR_PAL] = RGB(0, 0, 0);
+    PALRAM[COVER_BAR_PAL + 1] = RGB(31, 0, 0);
+  }
+  cover_blank_bit = 0;
+  LCDMODE = cover_lcdmode | hud_blank_bit;
+  cover_show = 0;
+  bar_page = NULL;
+}
+
+/* hud_blank() ********************
+   Turns the screen off, or back on showing what it did before.
+   VRAM keeps the cover and bar while it is off, and covers still
+   load.
+*/
+void hud_blank(int blank)
+{
+  hud_blank_bit = blank ? LCDMODE_BLANK : 0;
+  LCDMODE = (LCDMODE & ~LCDMODE_BLANK) | hud_blank_bit | cover_blank_bit;
 }
 
 void bmp16_rect(int left, int top, int right, int bottom, u32 clr,
@@ -192,4 +404,44 @@ void bmp16_rect(int left, int top, int right, int bottom, u32 clr,
     for(iy=0; iy<height; iy++)
         for(ix=0; ix<width; ix++)
             dst[iy*dstPitch + ix]= clr;
-}
\ No newline at end of file
+}
+
+/* hud_bar() ********************
+   Draws the progress bar up to x = right on the page that is
+   showing, in red if alert is set.
+*/
+void hud_bar(int right, int alert)
+{
+  unsigned int lcdmode = LCDMODE;
+  int mode4 = (lcdmode & 7) == 4;
+  u16 *page = VRAM;
+  int left = 4;
+
+  if(mode4 && (lcdmode & LCDMODE_PAGE(1)))
+    page += COVER_PAGE_LEN / 2;
+  alert = alert != 0;
+  if(page == bar_page && alert == bar_alert)
+  {
+    if(right <= bar_right)
+      return;
+    left = bar_right;
+  }
+  bar_page = page;
+  bar_right = right;
+  bar_alert = alert;
+  hal_work(HAL_WORK_BAR_PIXEL, (right - left) * 5);
+
+  if(mode4)
+  {
+    u16 c = (alert ? COVER_BAR_PAL + 1 : COVER_BAR_PAL) * 0x0101;
+    int x, y;
+
+    /* two pixels to a halfword */
+    for(y = 149; y < 154; y++)
+      for(x = left / 2; x < right / 2; x++)
+        page[y * 120 + x] = c;
+  }
+  else
+    bmp16_rect(left, 149, right, 154, alert ? RGB(31, 0, 0) : 0,
+               (void *)VRAM, 480);
+}
@@ -26,28 +26,32 @@ Visit http://www.pineight.com/ for more information.
 
 volatile int want_reset = 0;
 
-#include "pin8gba.h"
-
-#define INTACK          (*(volatile u16 *)0x04000202)
-#define BIOS_INTACK     (*(volatile u16 *)0x03007ff8)
-#define INTMASK_VBL     0x0001
-
-#define INTENABLE       (*(volatile u16 *)0x04000208)
+#include "hal.h"
 
 
 void dsound_vblank(void);
+int dsound_segment_done(void) __attribute__((long_call));
+void dsound_refill(void);
+void irq_call_nested(void (*fn)(void));
 
 void isr(void)
 {
-  unsigned int interrupts = INTACK;
+  unsigned int interrupts = hal_irq_ack();
 
 #if 0
-  if(interrupts & INTMASK_VBL)
+  if(interrupts & HAL_INT_VBLANK)
   {
     dsound_vblank();
   }
 #endif
-  BIOS_INTACK |= interrupts;
-  INTACK = interrupts;
+
+  /* TIMER[1] marks the end of each audio segment.  Decoding the
+     next ones takes a good part of a frame, so it runs nested where
+     vblank can still get through. */
+  if(interrupts & HAL_INT_TIMER1)
+  {
+    if(dsound_segment_done())
+      irq_call_nested(dsound_refill);
+  }
   INTENABLE = 1;
 }
@@ -28,11 +28,11 @@ IN THE SOFTWARE.
 
 /* This code assumes a LITTLE ENDIAN target.  It'll need a boatload
    of itohs and itohl calls if converted to run on Sega Genesis.  It
-   also assumes that the target uses 16-bit short and 32-bit longs.
+   also assumes that the target uses 16-bit short and 32-bit ints.
 */
 
 typedef unsigned short u16;
-typedef unsigned long u32;
+typedef unsigned int u32;
 
 #include <stdlib.h>
 #include <string.h>
@@ -48,6 +48,11 @@ typedef unsigned long u32;
    faster at the cost of a slightly larger binary. */
 #define GBFS_ALIGNMENT  256
 
+/* catbin -g writes the offset of the GBFS file from the start of ROM
+   into these reserved bytes of the cartridge header */
+#define GBFS_ROM_START  ((const char *)0x08000000)
+#define GBFS_HEADER_OFF ((const u32 *)0x080000b8)
+
 const GBFS_FILE *find_first_gbfs_file(const void *start)
 {
   /* align the pointer */
@@ -92,6 +97,25 @@ const GBFS_FILE *find_first_gbfs_file(const void *start)
 }
 
 
+/* find_header_gbfs_file() *************
+   Returns the GBFS file that catbin -g recorded in the cartridge
+   header, without searching, or 0 if there isn't one.
+*/
+const GBFS_FILE *find_header_gbfs_file(void)
+{
+  const char rest_of_magic[] = "ightGBFS\r\n\x1a\n";
+  u32 offset = *GBFS_HEADER_OFF;
+  const u32 *here = (const u32 *)(GBFS_ROM_START + offset);
+
+  /* 0 and anything else in the header itself mean not recorded */
+  if(offset < 0xc0 || offset >= 0x02000000 || (offset & 3))
+    return 0;
+  if(*here == 0x456e6950 && !memcmp(here + 1, rest_of_magic, 12))
+    return (const GBFS_FILE *)here;
+  return 0;
+}
+
+
 const void *skip_gbfs_file(const GBFS_FILE *file)
 {
   return ((char *)file + file->total_len);
@@ -104,6 +128,38 @@ static int namecmp(const void *a, const void *b)
 }
 
 
+/* hash_lookup() ***********************
+   Finds key (nul-padded to 24 bytes) through the name index that
+   gbfs -i adds.  Usually one memcmp instead of bsearch's log2(n).
+*/
+static const GBFS_ENTRY *hash_lookup(const GBFS_FILE *file,
+                                     const GBFS_ENTRY *dirbase,
+                                     const char *key)
+{
+  const u16 *slots = (const u16 *)((const char *)file + file->hash_off);
+  u32 mask = file->hash_nmemb - 1;
+  u32 h = GBFS_FNV_BASIS;
+  unsigned int i;
+
+  for(i = 0; i < 24 && key[i]; i++)
+  {
+    h ^= (unsigned char)key[i];
+    h *= GBFS_FNV_PRIME;
+  }
+
+  for(i = 0; i <= mask; i++)
+  {
+    unsigned int slot = slots[(h + i) & mask];
+
+    if(slot == 0)
+      return NULL;
+    if(!namecmp(key, dirbase[slot - 1].name))
+      return dirbase + slot - 1;
+  }
+  return NULL;
+}
+
+
 const void *gbfs_get_obj(const GBFS_FILE *file,
                          const char *name,
                          u32 *len)
@@ -116,9 +172,12 @@ const void *gbfs_get_obj(const GBFS_FILE *file,
 
   strncpy(key, name, 24);
 
-  here = bsearch(key, dirbase,
-                 n_entries, sizeof(GBFS_ENTRY),
-                 namecmp);
+  if(file->hash_off)
+    here = hash_lookup(file, dirbase, key);
+  else
+    here = bsearch(key, dirbase,
+                   n_entries, sizeof(GBFS_ENTRY),
+                   namecmp);
   if(!here)
     return NULL;
 
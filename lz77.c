@@ -0,0 +1,130 @@
+/* lz77.c
+   decode GBA BIOS LZ77 data into VRAM a slice at a time
+
+Copyright 2026 GBAWAVE contributors
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+
+*/
+
+/* The data is in the format that BIOS call 0x12 (LZ77UnCompVram)
+   takes: a 32-bit header of 0x10 | (length << 8), then groups of
+   eight items, each group led by a flag byte, MSB first.  A 0 flag
+   is a literal byte.  A 1 flag is a 16-bit big-endian copy command,
+   4 bits of length - 3 and 12 bits of distance - 1.
+
+   The BIOS does a whole image per call, which is several frames of
+   CPU for a cover, so this does the same job in slices that the
+   main loop can fit around everything else.  VRAM can't take byte
+   writes, so an even byte waits in lz_half until its odd neighbor
+   comes along.  Copies read back from VRAM.
+
+   Assemble it as lz77.iwram.o so that it runs from the 32-bit bus.
+*/
+
+#include "pin8gba.h"
+
+static const u8 *lz_src;
+static volatile u8 *lz_dst;
+static u32 lz_pos, lz_len;
+static u32 lz_flags;  /* flag bits left, MSB first, over a marker bit */
+static u32 lz_half;   /* even byte not yet written while lz_pos is odd */
+
+/* lz77_vram_start() ********************
+   Sets up to decode the LZ77 data at src to dst.  Returns the
+   length it decodes to, or 0 if src isn't LZ77 data.
+*/
+__attribute__((long_call)) u32 lz77_vram_start(const void *src, void *dst)
+{
+  const u8 *s = src;
+
+  lz_pos = lz_len = 0;
+  if(s[0] != 0x10)
+    return 0;
+  lz_len = s[1] | (s[2] << 8) | (s[3] << 16);
+  lz_src = s + 4;
+  lz_dst = dst;
+  lz_flags = 0;
+  lz_half = 0;
+  return lz_len;
+}
+
+/* lz77_vram_step() ********************
+   Decodes at least max_len more bytes, or up to the end, and
+   returns how many are left.  It can go up to 17 bytes over
+   max_len to finish a copy.
+*/
+__attribute__((long_call)) u32 lz77_vram_step(u32 max_len)
+{
+  const u8 *src = lz_src;
+  volatile u8 *dst = lz_dst;
+  u32 pos = lz_pos, len = lz_len;
+  u32 flags = lz_flags, half = lz_half;
+  u32 end = (len - pos > max_len) ? pos + max_len : len;
+
+  while(pos < end)
+  {
+    if((flags << 1) == 0)
+      flags = (*src++ << 24) | 0x00800000;
+
+    if(flags & 0x80000000)
+    {
+      u32 n = (src[0] >> 4) + 3;
+      u32 from = pos - (((src[0] & 0x0F) << 8) | src[1]) - 1;
+
+      src += 2;
+      if(n > len - pos)
+        n = len - pos;
+      for(; n > 0; n--, from++)
+      {
+        /* only a distance of 1 can land on the pending byte */
+        u32 c = (from == pos - 1 && (pos & 1)) ? half : dst[from];
+
+        if(pos & 1)
+          *(volatile u16 *)(dst + pos - 1) = half | (c << 8);
+        else
+          half = c;
+        pos++;
+      }
+    }
+    else
+    {
+      u32 c = *src++;
+
+      if(pos & 1)
+        *(volatile u16 *)(dst + pos - 1) = half | (c << 8);
+      else
+        half = c;
+      pos++;
+    }
+    flags <<= 1;
+  }
+
+  /* an odd length leaves one byte to write on its own */
+  if(pos == len && (pos & 1))
+    *(volatile u16 *)(dst + pos - 1) = half;
+
+  lz_src = src;
+  lz_pos = pos;
+  lz_flags = flags;
+  lz_half = half;
+  return len - pos;
+}
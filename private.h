@@ -15,9 +15,11 @@ typedef long			longword;	/* 32 bit signed int	*/
 typedef unsigned short		uword;		/* unsigned word	*/
 typedef unsigned long		ulongword;	/* unsigned longword	*/
 
+#define	GSM_DRP_RING	160	/* one frame of LTP history		*/
+
 struct gsm_state {
 
-	word		dp0[ 280 ];
+	word		dp0[ GSM_DRP_RING ];	/* long_term.c, ring	*/
 
 	word		z1;		/* preprocessing.c, Offset_com. */
 	longword	L_z2;		/*                  Offset_com. */
@@ -31,15 +33,62 @@ struct gsm_state {
 	word		nrp; /* 40 */	/* long_term.c, synthesis	*/
 	word		v[9];		/* short_term.c, synthesis	*/
 	word		msr;		/* decoder.c,	Postprocessing	*/
+	word		ups_last;	/* 2:1 upsampling, last output	*/
+	word		ups_hist[7];	/* upsampling taps, oldest 1st	*/
+	unsigned int	dith_rnd;	/* dither generator state	*/
+	word		dith_err[2];	/* dither, last 2 errors	*/
 
 	char		verbose;	/* only used if !NDEBUG		*/
-	char		fast;		/* only used if FAST		*/
 
 	char		wav_fmt;	/* only used if WAV49 defined	*/
 	unsigned char	frame_index;	/*            odd/even chaining	*/
 	unsigned char	frame_chain;	/*   half-byte to carry forward	*/
 };
 
+/* The parameters of one frame, unpacked in the order that
+ * Gsm_Decoder() consumes them.
+ */
+struct gsm_params {
+
+	word		LARc[8];
+
+	struct gsm_subframe_params {
+		word	Nc, bc, Mc, xmaxc;
+		word	xmc[13];
+	} sub[4];
+};
+
+/* The decoder state at a frame boundary, as gsm_snapshot_save()
+ * leaves it.  Only dp0[40..159] can be read before the next frame
+ * overwrites it, since the LTP lag is at most 120.  It is all words,
+ * so it has the same layout on the PC and the GBA.
+ */
+struct gsm_snapshot {
+
+	word		dp0[ GSM_DRP_RING - 40 ];
+	word		LARpp[2][8];
+	word		j;
+	word		nrp;
+	word		v[9];
+	word		msr;
+};
+
+/* A song in the GBFS archive may end with a seek table, which
+ * tools/gbfs.c appends to every .gsm file it packs:
+ *
+ *	GSM frames, 33 bytes each
+ *	zero padding to a multiple of 4 bytes
+ *	struct gsm_snapshot for the state before frame interval,
+ *	    2 * interval, ...
+ *	trailer of 4 little-endian 32-bit words: length of the
+ *	    frames, offset of the first snapshot, interval, and
+ *	    GSM_SEEK_MAGIC
+ *
+ * Offsets count from the start of the object.
+ */
+#define	GSM_SEEK_MAGIC		0x4B454553	/* "SEEK" */
+#define	GSM_SEEK_TRAILER_LEN	16
+
 
 #define	MIN_WORD	(-32767 - 1)
 #define	MAX_WORD	  32767
@@ -0,0 +1,154 @@
+/* profile.c
+   per-stage cycle counts for the GSM player
+*/
+
+/*
+ * Copyright 2026 GBAWAVE contributors.
+ * See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+ * THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+ */
+
+/* See profile.h.  This goes in ROM as profile.o, because
+   prof_frame() divides; the decoder in IWRAM reaches prof_commit()
+   with a long call. */
+
+#include <string.h>
+#include "profile.h"
+
+static const char prof_names[PROF_N_STAGES][8] =
+{
+  "unpack", "rpe", "ltp", "stsf", "post", "seg", "hud"
+};
+
+u32 prof_t0[PROF_N_STAGES], prof_acc[PROF_N_STAGES];
+volatile u32 prof_nested;
+
+static struct PROF_STATS prof_cur[PROF_N_STAGES];
+static struct PROF_STATS prof_ring[PROF_RING][PROF_N_STAGES];
+static u32 prof_windows;
+static unsigned int prof_frames;
+
+static void prof_clear(struct PROF_STATS *st)
+{
+  unsigned int i;
+
+  for(i = 0; i < PROF_N_STAGES; i++)
+  {
+    st[i].min = ~0U;
+    st[i].max = st[i].sum = st[i].count = 0;
+  }
+}
+
+/* prof_commit() **************
+   Adds the cycles stage has run since its last commit to its
+   statistics as one sample.
+*/
+void prof_commit(unsigned int stage)
+{
+  struct PROF_STATS *st = prof_cur + stage;
+  u32 c = prof_acc[stage];
+
+  prof_acc[stage] = 0;
+  if(stage == PROF_SEG)
+    prof_nested += c;
+  if(st->count == 0)
+    st->min = ~0U;
+  if(c < st->min)
+    st->min = c;
+  if(c > st->max)
+    st->max = c;
+  st->sum += c;
+  st->count++;
+}
+
+/* prof_utoa() **************
+   Writes n in decimal to dst and returns the end.
+*/
+static char *prof_utoa(char *dst, u32 n)
+{
+  char buf[10];
+  unsigned int len = 0;
+
+  do
+  {
+    buf[len++] = '0' + n % 10;
+    n /= 10;
+  } while(n);
+  while(len > 0)
+    *dst++ = buf[--len];
+  return dst;
+}
+
+static char *prof_puts(char *dst, const char *s)
+{
+  while(*s)
+    *dst++ = *s++;
+  return dst;
+}
+
+/* prof_log() **************
+   Sends one window's numbers to the emulator's log.
+*/
+static void prof_log(u32 window, const struct PROF_STATS *st)
+{
+  unsigned int i;
+
+  for(i = 0; i < PROF_N_STAGES; i++)
+  {
+    char line[80];
+    char *s = prof_puts(line, "prof ");
+
+    s = prof_utoa(s, window);
+    *s++ = ' ';
+    s = prof_puts(s, prof_names[i]);
+    s = prof_puts(s, " n=");
+    s = prof_utoa(s, st[i].count);
+    if(st[i].count)
+    {
+      s = prof_puts(s, " min=");
+      s = prof_utoa(s, st[i].min);
+      s = prof_puts(s, " mean=");
+      s = prof_utoa(s, st[i].sum / st[i].count);
+      s = prof_puts(s, " max=");
+      s = prof_utoa(s, st[i].max);
+    }
+    *s = 0;
+    hal_debug_log(line);
+  }
+}
+
+/* prof_frame() **************
+   Call once per video frame from the main loop.  Every PROF_WINDOW
+   frames, files the numbers so far and starts over.
+*/
+void prof_frame(void)
+{
+  unsigned int slot = prof_windows % PROF_RING;
+  struct PROF_STATS *st = prof_ring[slot];
+  u8 header[16];
+
+  if(++prof_frames < PROF_WINDOW)
+    return;
+  prof_frames = 0;
+
+  INTENABLE = 0;
+  memcpy(st, prof_cur, sizeof(prof_cur));
+  prof_clear(prof_cur);
+  INTENABLE = 1;
+  prof_windows++;
+
+  memcpy(header, PROF_SRAM_MAGIC, 8);
+  header[8] = prof_windows;
+  header[9] = prof_windows >> 8;
+  header[10] = prof_windows >> 16;
+  header[11] = prof_windows >> 24;
+  header[12] = PROF_N_STAGES;
+  header[13] = PROF_RING;
+  header[14] = PROF_WINDOW & 0xff;
+  header[15] = PROF_WINDOW >> 8;
+  hal_sram_write(PROF_SRAM_OFF + 16 + slot * sizeof(prof_cur),
+                 st, sizeof(prof_cur));
+  hal_sram_write(PROF_SRAM_OFF, header, sizeof(header));
+
+  prof_log(prof_windows - 1, st);
+}
@@ -0,0 +1,83 @@
+/* profile.h
+   per-stage cycle counts for the GSM player
+*/
+
+/*
+ * Copyright 2026 GBAWAVE contributors.
+ * See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+ * THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+ */
+
+/* Build with PROFILE = 1 in the makefile, which defines GSM_PROFILE,
+   and PROF_BEGIN() and PROF_END() read hal_cycles() around each
+   stage of playback.  Otherwise they compile to nothing, and
+   tools that build gsmcode.c for the PC never see any of this.
+
+   A stage can run in pieces between PROF_BEGIN() and PROF_END()
+   pairs; PROF_COMMIT() closes one sample of it, such as a frame, and
+   adds the sample to the stage's min, max, and mean.  PROF_SEG runs
+   in the TIMER[1] IRQ, and its time comes out of any other stage it
+   cuts into, so PROF_HUD is the main loop's own work.
+
+   Every PROF_WINDOW video frames, prof_frame() moves the numbers
+   into a ring of the last PROF_RING windows, copies the new window
+   to battery SRAM at PROF_SRAM_OFF, and sends it to the emulator's
+   debug log as one line per stage.  tools/savdump prints the SRAM
+   copy. */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+enum PROF_STAGE
+{
+  PROF_UNPACK,  /* Unpack_frame(), per frame */
+  PROF_RPE,     /* Gsm_RPE_Decoding(), per frame */
+  PROF_LTP,     /* Gsm_Long_Term_Synthesis_Filtering(), per frame */
+  PROF_STSF,    /* Gsm_Short_Term_Synthesis_Filter(), per frame */
+  PROF_POST,    /* gsm_postprocess_s8(), per segment */
+  PROF_SEG,     /* dsound_fill_seg() in all, per segment */
+  PROF_HUD,     /* the rest of streaming_run(), per video frame */
+  PROF_N_STAGES
+};
+
+#define PROF_WINDOW 60
+#define PROF_RING 8
+#define PROF_SRAM_OFF 0x4000
+
+/* In SRAM, all little-endian:
+   PROF_SRAM_MAGIC, 8 bytes
+   u32 windows written so far; window n is in ring slot n % PROF_RING
+   u8 PROF_N_STAGES, u8 PROF_RING, u16 PROF_WINDOW
+   PROF_RING records of PROF_N_STAGES struct PROF_STATS */
+#define PROF_SRAM_MAGIC "GSMPROF1"
+
+#ifdef GSM_PROFILE
+
+#include "hal.h"
+
+struct PROF_STATS
+{
+  u32 min, max, sum, count;  /* cycles; min is ~0 if count is 0 */
+};
+
+extern u32 prof_t0[PROF_N_STAGES], prof_acc[PROF_N_STAGES];
+extern volatile u32 prof_nested;
+
+#define PROF_BEGIN(stage) \
+  (prof_t0[stage] = hal_cycles() - prof_nested)
+#define PROF_END(stage) \
+  (prof_acc[stage] += hal_cycles() - prof_nested - prof_t0[stage])
+#define PROF_COMMIT(stage) prof_commit(stage)
+
+void prof_commit(unsigned int stage) __attribute__((long_call));
+void prof_frame(void) __attribute__((long_call));
+
+#else
+
+#define PROF_BEGIN(stage) ((void)0)
+#define PROF_END(stage) ((void)0)
+#define PROF_COMMIT(stage) ((void)0)
+#define prof_frame() ((void)0)
+
+#endif
+#endif
@@ -0,0 +1,151 @@
+@ void gsm_stsf_arm(word *v, const word *rrp, int k,
+@                   const word *wt, word *sr)
+@ Short term synthesis filter for the GSM decoder (4.3.2 in the spec,
+@ Short_term_synthesis_filtering() in gsmcode.c).  Filters wt[0..k-1]
+@ into sr[0..k-1] through the 8-tap lattice described by rrp[0..7],
+@ updating the filter state v[0..8].  k must be at least 1.  wt and
+@ sr may be the same buffer.
+@
+@ This has to stay bit-exact with the C version, so v[] values get
+@ truncated to 16 bits after every update exactly as storing to a
+@ word would, and sri is left as a full int within one sample.
+@
+@ v[0..7] live in r3-r10 and rrp[0..7] live packed two per register
+@ in r11, r12, lr, and sp for the whole call.  v[8] is never read
+@ inside the loop, so it goes to a scratch word once per sample.
+@ wt is reached as sr plus a byte offset that is also kept in a
+@ scratch word.
+@ Using sp as a data register is safe because the BIOS IRQ handler
+@ runs on the banked IRQ mode stack.  isr.c only leaves IRQ mode for
+@ dsound_refill(), which is also the decoder's only caller and never
+@ nests, so it cannot land on this sp.  Nothing in here may push,
+@ pop, or swi.
+@
+@ Per sample this is 8 steps of 9 to 12 register-only instructions
+@ instead of 16 halfword loads and 9 halfword stores.  Assemble it
+@ as stsf.iwram.o so that it runs from the 32-bit bus.
+
+.ARM
+.ALIGN
+.GLOBL  gsm_stsf_arm
+
+@ rrp*v and rrp*sri products for the rrp in the top half of \rpack
+.macro  STSF_STEP_HI rpack, vi, vnext
+  mov   r2, \rpack, asr #16
+  mul   r2, \vi, r2
+  add   r2, r2, #0x4000
+  sub   r1, r1, r2, asr #15
+  mov   r2, \rpack, asr #16
+  mul   r2, r1, r2
+  add   r2, r2, #0x4000
+  add   \vnext, \vi, r2, asr #15
+  mov   \vnext, \vnext, lsl #16
+  mov   \vnext, \vnext, asr #16
+.endm
+
+@ same for the rrp in the bottom half of \rpack
+.macro  STSF_STEP_LO rpack, vi, vnext
+  mov   r2, \rpack, lsl #16
+  mov   r2, r2, asr #16
+  mul   r2, \vi, r2
+  add   r2, r2, #0x4000
+  sub   r1, r1, r2, asr #15
+  mov   r2, \rpack, lsl #16
+  mov   r2, r2, asr #16
+  mul   r2, r1, r2
+  add   r2, r2, #0x4000
+  add   \vnext, \vi, r2, asr #15
+  mov   \vnext, \vnext, lsl #16
+  mov   \vnext, \vnext, asr #16
+.endm
+
+gsm_stsf_arm:
+  stmfd sp!, {r4-r11, lr}
+  str   r0, stsf_v
+  str   r2, stsf_count
+  ldr   r4, [sp, #36]
+  sub   r3, r3, r4
+  str   r3, stsf_wt_off
+  mov   r3, r4
+
+  @ pack rrp[] as (rrp[2i+1] << 16) | (rrp[2i] & 0xFFFF)
+  ldrh  r11, [r1, #0]
+  ldrh  r4, [r1, #2]
+  orr   r11, r11, r4, lsl #16
+  ldrh  r12, [r1, #4]
+  ldrh  r4, [r1, #6]
+  orr   r12, r12, r4, lsl #16
+  ldrh  lr, [r1, #8]
+  ldrh  r4, [r1, #10]
+  orr   lr, lr, r4, lsl #16
+  ldrh  r5, [r1, #12]
+  ldrh  r4, [r1, #14]
+  orr   r5, r5, r4, lsl #16
+  str   sp, stsf_sp
+  mov   sp, r5
+
+  mov   r2, r0
+  mov   r0, r3
+  ldrsh r3, [r2, #0]
+  ldrsh r4, [r2, #2]
+  ldrsh r5, [r2, #4]
+  ldrsh r6, [r2, #6]
+  ldrsh r7, [r2, #8]
+  ldrsh r8, [r2, #10]
+  ldrsh r9, [r2, #12]
+  ldrsh r10, [r2, #14]
+
+0:
+  ldr   r2, stsf_wt_off
+  ldrsh r1, [r0, r2]
+
+  @ step 7 produces v[8], which only matters after the last sample
+  mov   r2, sp, asr #16
+  mul   r2, r10, r2
+  add   r2, r2, #0x4000
+  sub   r1, r1, r2, asr #15
+  mov   r2, sp, asr #16
+  mul   r2, r1, r2
+  add   r2, r2, #0x4000
+  add   r2, r10, r2, asr #15
+  str   r2, stsf_v8
+
+  STSF_STEP_LO sp, r9, r10
+  STSF_STEP_HI lr, r8, r9
+  STSF_STEP_LO lr, r7, r8
+  STSF_STEP_HI r12, r6, r7
+  STSF_STEP_LO r12, r5, r6
+  STSF_STEP_HI r11, r4, r5
+  STSF_STEP_LO r11, r3, r4
+
+  strh  r1, [r0], #2
+  mov   r3, r1, lsl #16
+  mov   r3, r3, asr #16
+
+  ldr   r2, stsf_count
+  subs  r2, r2, #1
+  str   r2, stsf_count
+  bne   0b
+
+  ldr   r2, stsf_v
+  strh  r3, [r2, #0]
+  strh  r4, [r2, #2]
+  strh  r5, [r2, #4]
+  strh  r6, [r2, #6]
+  strh  r7, [r2, #8]
+  strh  r8, [r2, #10]
+  strh  r9, [r2, #12]
+  strh  r10, [r2, #14]
+  ldr   r1, stsf_v8
+  strh  r1, [r2, #16]
+
+  ldr   sp, stsf_sp
+  ldmfd sp!, {r4-r11, lr}
+  bx    lr
+
+@ scratch words, kept next to the code for pc-relative access
+stsf_v:     .word 0
+stsf_sp:    .word 0
+stsf_count: .word 0
+stsf_v8:    .word 0
+stsf_wt_off: .word 0
@@ -0,0 +1,147 @@
+/* telemetry.c
+   how well playback kept up, kept in battery SRAM
+*/
+
+/*
+ * Copyright 2026 GBAWAVE contributors.
+ * See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+ * THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+ */
+
+#include <string.h>
+#include "hal.h"
+#include "telemetry.h"
+
+/* emulators give a ROM with this string battery SRAM */
+const char tele_sram_id[] = "SRAM_V113";
+
+extern volatile unsigned int dsound_played, dsound_filled;
+extern volatile unsigned int dsound_underruns;
+
+struct TELE_RECORD tele;
+
+static int tele_changing;
+static u32 tele_change_frames, tele_change_base;
+
+static u32 tele_sum(const struct TELE_RECORD *r)
+{
+  const u32 *w = &r->seq;
+  u32 sum = 0;
+
+  while(w < &r->check)
+    sum += *w++;
+  return sum;
+}
+
+/* tele_init() **************
+   Picks up the newest good record in SRAM, or starts a new one, and
+   counts a boot.
+*/
+void tele_init(void)
+{
+  struct TELE_RECORD slot;
+  unsigned int i;
+  int found = 0;
+
+  for(i = 0; i < 2; i++)
+  {
+    hal_sram_read(TELE_SRAM_OFF + i * TELE_SLOT_LEN, &slot, sizeof(slot));
+    if(!memcmp(slot.magic, TELE_SRAM_MAGIC, 8)
+       && slot.check == tele_sum(&slot)
+       && (!found || slot.seq > tele.seq))
+    {
+      tele = slot;
+      found = 1;
+    }
+  }
+  if(!found)
+  {
+    memset(&tele, 0, sizeof(tele));
+    memcpy(tele.magic, TELE_SRAM_MAGIC, 8);
+    tele.change_min_lead = TELE_LEADS;
+  }
+  tele.boots++;
+}
+
+/* tele_save() **************
+   Writes the record to the older slot.  Runs in the TIMER[1] IRQ,
+   so nothing changes under it.
+*/
+static void tele_save(void)
+{
+  tele.seq++;
+  tele.check = tele_sum(&tele);
+  hal_sram_write(TELE_SRAM_OFF + (tele.seq & 1) * TELE_SLOT_LEN,
+                 &tele, sizeof(tele));
+}
+
+/* tele_segment() **************
+   Counts a segment starting to play with lead segments decoded,
+   itself included, and saves the record now and then.  Called from
+   the TIMER[1] IRQ.
+*/
+void tele_segment(int lead)
+{
+  if(lead < 0)
+    lead = 0;
+  if(lead >= TELE_LEADS)
+    lead = TELE_LEADS - 1;
+  tele.lead_hist[lead]++;
+  if(++tele.segments % TELE_SAVE_SEGS == 0)
+    tele_save();
+}
+
+/* tele_fill() **************
+   Counts a segment that took cycles to decode.  Called from the
+   TIMER[1] IRQ.
+*/
+void tele_fill(u32 cycles)
+{
+  u32 bin = cycles / TELE_FILL_BIN_LEN;
+
+  if(bin >= TELE_FILL_BINS)
+    bin = TELE_FILL_BINS - 1;
+  tele.fill_hist[bin]++;
+  if(cycles > tele.worst_fill)
+    tele.worst_fill = cycles;
+}
+
+/* tele_frame() **************
+   Call once per video frame from the main loop, with the cycles it
+   has been busy since vblank, whether a track change started, and
+   whether a cover is still loading.
+*/
+void tele_frame(u32 busy, int change, int loading)
+{
+  if(busy > tele.worst_main)
+    tele.worst_main = busy;
+
+  /* a change made while the last one loads runs on as one stall */
+  if(change)
+  {
+    tele.changes++;
+    if(!tele_changing)
+    {
+      tele_changing = 1;
+      tele_change_frames = 0;
+      tele_change_base = dsound_underruns;
+    }
+  }
+  if(tele_changing)
+  {
+    unsigned int lead = dsound_filled - dsound_played;
+
+    tele_change_frames++;
+    if(busy > tele.worst_change_main)
+      tele.worst_change_main = busy;
+    if(lead < tele.change_min_lead)
+      tele.change_min_lead = lead;
+    if(!loading)
+    {
+      if(tele_change_frames > tele.worst_change_frames)
+        tele.worst_change_frames = tele_change_frames;
+      tele.change_underruns += dsound_underruns - tele_change_base;
+      tele_changing = 0;
+    }
+  }
+}
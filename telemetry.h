@@ -0,0 +1,75 @@
+/* telemetry.h
+   how well playback kept up, kept in battery SRAM
+*/
+
+/*
+ * Copyright 2026 GBAWAVE contributors.
+ * See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+ * THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+ */
+
+/* The player always keeps these counts, from the first time a cart
+   is switched on, so that a cart that glitched in someone's hands
+   can say how.  The record goes to battery SRAM every
+   TELE_SAVE_SEGS segments, from the TIMER[1] IRQ so that it still
+   gets saved when decoding starves the main loop, in two slots taken
+   in turn so that switching off during a write loses at most the
+   newest copy.  tools/savdump prints it.
+
+   In SRAM, at TELE_SRAM_OFF and TELE_SRAM_OFF + TELE_SLOT_LEN, each
+   slot is a struct TELE_RECORD: TELE_SRAM_MAGIC, then little-endian
+   u32s ending in check, the sum of all the u32s before it.  The one
+   with the higher seq wins. */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#define TELE_SRAM_OFF 0x0000
+#define TELE_SLOT_LEN 0x80
+#define TELE_SRAM_MAGIC "GSMTELE2"
+#define TELE_SAVE_SEGS 240   /* 4 seconds */
+#define TELE_LEADS 4        /* DSOUND_SEGS in gsmplay.c */
+#define TELE_FILL_BINS 9
+#define TELE_FILL_BIN_LEN 35112  /* an eighth of a video frame */
+
+struct TELE_RECORD
+{
+  char magic[8];
+  u32 seq;                /* saves so far */
+  u32 boots;
+  u32 segments;           /* segments played */
+
+  /* segments decoded ahead of the one starting, by segment; 0 is a
+     missed swap, where DMA1 reached a segment before it was decoded */
+  u32 lead_hist[TELE_LEADS];
+
+  /* segments by cycles taken to decode, in bins of
+     TELE_FILL_BIN_LEN; the last bin is a frame or more */
+  u32 fill_hist[TELE_FILL_BINS];
+  u32 worst_fill;         /* cycles, one segment */
+  u32 worst_main;         /* cycles, main loop from vblank to done */
+
+  /* track changes, from the button press until the cover is up */
+  u32 changes;
+  u32 change_underruns;   /* missed swaps during them */
+  u32 worst_change_frames;
+  u32 worst_change_main;  /* cycles, main loop in a frame of one */
+  u32 change_min_lead;    /* fewest segments queued during one */
+
+  /* the latest boot, in cycles from hal_init() (crt0 isn't counted)
+     until the GBFS file was found and until DMA1 started on the
+     first decoded segment */
+  u32 boot_gbfs_cycles;
+  u32 boot_audio_cycles;
+
+  u32 check;
+};
+
+extern struct TELE_RECORD tele;
+
+void tele_init(void);
+void tele_segment(int lead);
+void tele_fill(u32 cycles);
+void tele_frame(u32 busy, int change, int loading);
+
+#endif
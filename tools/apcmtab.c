@@ -0,0 +1,130 @@
+/* apcmtab.c
+   generate the RPE inverse quantization table for gsmcode.c
+
+Copyright 2026 GBAWAVE contributors.
+Based on GSM RPE-LTP 1.0.10, Copyright 1992-1994 by Jutta Degener
+and Carsten Bormann, Technische Universitaet Berlin.
+See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+
+*/
+
+/* A decoded RPE sample xMp depends only on the 6-bit block maximum
+   xmaxc and the 3-bit sample code xMc.  This program runs 4.2.15 and
+   4.2.16 from the spec for all 64 * 8 combinations and writes the
+   results as a C header:
+
+     apcmtab apcmtab.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../private.h"
+
+static const word apcm_FAC[8] = { 18431, 20479, 22527, 24575, 26623, 28671, 30719, 32767 };
+
+static const char help_text[] =
+"Generates the APCM inverse quantization table for gsmcode.c.\n"
+"usage: apcmtab OUTFILE\n";
+
+
+static word gsm_asr(word a, int n)
+{
+  if (n >= 16) return -(a < 0);
+  if (n <= -16) return 0;
+  if (n < 0) return a << -n;
+  return SASR(a, n);
+}
+
+static word gsm_asl(word a, int n)
+{
+  if (n >= 16) return 0;
+  if (n <= -16) return -(a < 0);
+  if (n < 0) return gsm_asr(a, -n);
+  return a << n;
+}
+
+
+/* 4.2.15 */
+static void xmaxc_to_exp_mant(word xmaxc, word *exp_out, word *mant_out)
+{
+  word exp, mant;
+
+  exp = 0;
+  if (xmaxc > 15) exp = SASR(xmaxc, 3) - 1;
+  mant = xmaxc - (exp << 3);
+
+  if (mant == 0) {
+    exp  = -4;
+    mant = 7;
+  }
+  else {
+    while (mant <= 7) {
+      mant = mant << 1 | 1;
+      exp--;
+    }
+    mant -= 8;
+  }
+
+  *exp_out  = exp;
+  *mant_out = mant;
+}
+
+
+/* 4.2.16, one sample */
+static word inverse_quantize(word xMc, word mant, word exp)
+{
+  word temp, temp1, temp2, temp3;
+  longword ltmp;
+
+  temp1 = apcm_FAC[ mant ];
+  temp2 = GSM_SUB( 6, exp );
+  temp3 = gsm_asl( 1, GSM_SUB( temp2, 1 ));
+
+  temp = (xMc << 1) - 7;          /* restore sign   */
+  temp <<= 12;                    /* 16 bit signed  */
+  temp = GSM_MULT_R( temp1, temp );
+  temp = GSM_ADD( temp, temp3 );
+  return temp >> temp2;
+}
+
+
+int main(int argc, char **argv)
+{
+  FILE *fp;
+  unsigned int xmaxc, xMc;
+
+  if(argc != 2)
+  {
+    fputs(help_text, stderr);
+    return 1;
+  }
+
+  fp = fopen(argv[1], "w");
+  if(!fp)
+  {
+    fputs("apcmtab could not open output file ", stderr);
+    perror(argv[1]);
+    return 1;
+  }
+
+  fputs("/* generated by tools/apcmtab.c; do not edit */\n\n"
+        "/* gsm_xMp_tab[xmaxc][xMc] */\n"
+        "static const word gsm_xMp_tab[64][8] =\n{\n", fp);
+  for(xmaxc = 0; xmaxc < 64; xmaxc++)
+  {
+    word exp, mant;
+
+    xmaxc_to_exp_mant(xmaxc, &exp, &mant);
+    fputs("  {", fp);
+    for(xMc = 0; xMc < 8; xMc++)
+      fprintf(fp, " %6d%s", inverse_quantize(xMc, mant, exp),
+              xMc < 7 ? "," : "");
+    fprintf(fp, " },  /* %2u */\n", xmaxc);
+  }
+  fputs("};\n", fp);
+
+  fclose(fp);
+  return 0;
+}
@@ -0,0 +1,458 @@
+/* armstsf.c
+   run stsf.s on the host for a bit-exact check against the C filter
+
+Copyright 2026 GBAWAVE contributors.
+See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+
+*/
+
+/* Linked into gsmdec-arm in place of stsf.iwram.o, this gives a host
+   build of gsmcode.c with GSM_STSF_ASM a gsm_stsf_arm() that runs the
+   real machine code of stsf.s, assembled by the GBA toolchain to the
+   raw binary stsf.bin, in a small ARM7TDMI interpreter.  Decoding the
+   same song with gsmdec and gsmdec-arm and comparing the two outputs
+   then checks the assembly against the C filter bit for bit.
+
+   The interpreter knows only the instructions stsf.s uses: data
+   processing with an immediate shift, MUL, LDR/STR, the halfword
+   transfers, LDM/STM, B, and BX.  It counts cycles as the ARM7TDMI
+   takes them from IWRAM, where every access is one cycle:
+     data processing  1, or 3 writing pc
+     MUL              1 + 1 to 4 by the significant bytes of Rs
+     LDR, LDRH        3
+     STR, STRH        2
+     LDM              n + 2, STM n + 1
+     B, BX            3
+   armstsf_cycles adds them up over every call.
+
+   The binary comes from the file named by the STSF_BIN environment
+   variable, or stsf.bin in the current directory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../private.h"
+
+#define MEM_LEN 0x10000
+#define CODE_MAX 0x1000
+#define V_ADDR 0x8000
+#define RRP_ADDR 0x8040
+#define WT_ADDR 0x8100
+#define SR_ADDR 0x8400
+#define SP_ADDR 0xff00
+#define RETURN_ADDR 0xfffffff0u
+
+unsigned long armstsf_cycles;
+
+static unsigned char mem[MEM_LEN];
+static int code_loaded;
+
+static unsigned int r[16];
+static int flag_n, flag_z, flag_c, flag_v;
+
+static void arm_fail(const char *why, unsigned int addr)
+{
+  fprintf(stderr, "armstsf: %s at $%08x\n", why, addr);
+  exit(1);
+}
+
+static unsigned int mem_rd(unsigned int addr, unsigned int len)
+{
+  unsigned int v = 0;
+
+  if(addr >= MEM_LEN || addr + len > MEM_LEN || (addr & (len - 1)))
+    arm_fail("bad load", addr);
+  while(len-- > 0)
+    v = v << 8 | mem[addr + len];
+  return v;
+}
+
+static void mem_wr(unsigned int addr, unsigned int len, unsigned int v)
+{
+  unsigned int i;
+
+  if(addr >= MEM_LEN || addr + len > MEM_LEN || (addr & (len - 1)))
+    arm_fail("bad store", addr);
+  for(i = 0; i < len; i++, v >>= 8)
+    mem[addr + i] = v;
+}
+
+static void load_code(void)
+{
+  const char *name = getenv("STSF_BIN");
+  FILE *fp;
+  size_t len;
+
+  if(!name)
+    name = "stsf.bin";
+  fp = fopen(name, "rb");
+  if(!fp)
+  {
+    fputs("armstsf could not open ", stderr);
+    perror(name);
+    exit(1);
+  }
+  len = fread(mem, 1, CODE_MAX, fp);
+  fclose(fp);
+  if(len < 16)
+  {
+    fprintf(stderr, "armstsf: %s is not stsf.s\n", name);
+    exit(1);
+  }
+  code_loaded = 1;
+}
+
+static int cond_passed(unsigned int ins)
+{
+  switch(ins >> 28)
+  {
+  case 0x0: return flag_z;
+  case 0x1: return !flag_z;
+  case 0x2: return flag_c;
+  case 0x3: return !flag_c;
+  case 0x4: return flag_n;
+  case 0x5: return !flag_n;
+  case 0xA: return flag_n == flag_v;
+  case 0xB: return flag_n != flag_v;
+  case 0xC: return !flag_z && flag_n == flag_v;
+  case 0xD: return flag_z || flag_n != flag_v;
+  case 0xE: return 1;
+  }
+  arm_fail("unknown condition", r[15]);
+  return 0;
+}
+
+/* reg_operand() **************
+   Reads register operand bits 0-11 with a shift by an immediate,
+   setting *carry to the shifter's carry out.
+*/
+static unsigned int reg_operand(unsigned int ins, unsigned int pc,
+                                int *carry)
+{
+  unsigned int rm = ins & 15;
+  unsigned int v = rm == 15 ? pc + 8 : r[rm];
+  unsigned int amount = (ins >> 7) & 31;
+
+  if(ins & 0x10)
+    arm_fail("shift by register", pc);
+  switch((ins >> 5) & 3)
+  {
+  case 0:  /* LSL */
+    if(amount)
+    {
+      *carry = (v >> (32 - amount)) & 1;
+      v <<= amount;
+    }
+    break;
+  case 1:  /* LSR */
+    if(!amount)
+      amount = 32;
+    *carry = (v >> (amount - 1)) & 1;
+    v = amount == 32 ? 0 : v >> amount;
+    break;
+  case 2:  /* ASR */
+    if(!amount)
+      amount = 32;
+    *carry = (v >> (amount - 1)) & 1;
+    v = amount == 32 ? (unsigned int)-(int)(v >> 31)
+                     : (unsigned int)((int)v >> amount);
+    break;
+  default:
+    arm_fail("ROR", pc);
+  }
+  return v;
+}
+
+static void data_processing(unsigned int ins, unsigned int pc)
+{
+  unsigned int op = (ins >> 21) & 15;
+  unsigned int rd = (ins >> 12) & 15;
+  unsigned int rn = (ins >> 16) & 15;
+  unsigned int a = rn == 15 ? pc + 8 : r[rn];
+  unsigned int b, res;
+  int carry = flag_c, overflow = flag_v, writes = 1;
+
+  if(ins & 0x02000000)
+  {
+    unsigned int rot = ((ins >> 8) & 15) * 2;
+
+    b = ins & 0xFF;
+    if(rot)
+    {
+      b = (b >> rot) | (b << (32 - rot));
+      carry = b >> 31;
+    }
+  }
+  else
+    b = reg_operand(ins, pc, &carry);
+
+  switch(op)
+  {
+  case 0x0: case 0x8: res = a & b; writes = op == 0x0; break;
+  case 0x1: case 0x9: res = a ^ b; writes = op == 0x1; break;
+  case 0x2: case 0xA:
+    res = a - b;
+    carry = a >= b;
+    overflow = ((a ^ b) & (a ^ res)) >> 31;
+    writes = op == 0x2;
+    break;
+  case 0x3:
+    res = b - a;
+    carry = b >= a;
+    overflow = ((b ^ a) & (b ^ res)) >> 31;
+    break;
+  case 0x4: case 0xB:
+    res = a + b;
+    carry = res < a;
+    overflow = (~(a ^ b) & (a ^ res)) >> 31;
+    writes = op == 0x4;
+    break;
+  case 0xC: res = a | b; break;
+  case 0xD: res = b; break;
+  case 0xE: res = a & ~b; break;
+  case 0xF: res = ~b; break;
+  default:
+    arm_fail("unknown ALU op", pc);
+    return;
+  }
+  if(ins & 0x00100000)
+  {
+    flag_n = res >> 31;
+    flag_z = res == 0;
+    flag_c = carry;
+    flag_v = overflow;
+  }
+  if(writes)
+  {
+    r[rd] = res;
+    if(rd == 15)
+      armstsf_cycles += 2;
+    else
+      r[15] = pc + 4;
+  }
+  else
+    r[15] = pc + 4;
+  armstsf_cycles++;
+}
+
+static void multiply(unsigned int ins, unsigned int pc)
+{
+  unsigned int rd = (ins >> 16) & 15;
+  unsigned int rs = r[(ins >> 8) & 15];
+  unsigned int res = r[ins & 15] * rs;
+  unsigned int m;
+
+  /* early termination on the bytes of Rs that are all 0 or all 1 */
+  for(m = 1; m < 4; m++)
+  {
+    unsigned int top = rs >> (8 * m);
+
+    if(top == 0 || top == (0xFFFFFFFFu >> (8 * m)))
+      break;
+  }
+  if(ins & 0x00200000)
+  {
+    res += r[(ins >> 12) & 15];
+    m++;
+  }
+  if(ins & 0x00100000)
+  {
+    flag_n = res >> 31;
+    flag_z = res == 0;
+  }
+  r[rd] = res;
+  r[15] = pc + 4;
+  armstsf_cycles += 1 + m;
+}
+
+/* transfer() **************
+   LDR, STR, and the halfword and signed transfers.
+*/
+static void transfer(unsigned int ins, unsigned int pc, int half)
+{
+  unsigned int rn = (ins >> 16) & 15;
+  unsigned int rd = (ins >> 12) & 15;
+  unsigned int base = rn == 15 ? pc + 8 : r[rn];
+  unsigned int offset, addr;
+  int pre = ins & 0x01000000, up = ins & 0x00800000;
+  int load = ins & 0x00100000;
+  int dummy;
+
+  if(half)
+    offset = (ins & 0x00400000) ? ((ins >> 4) & 0xF0) | (ins & 0xF)
+                                : r[ins & 15];
+  else if(ins & 0x02000000)
+    offset = reg_operand(ins, pc, &dummy);
+  else
+    offset = ins & 0xFFF;
+  if(!up)
+    offset = -offset;
+  addr = pre ? base + offset : base;
+  r[15] = pc + 4;
+
+  if(load)
+  {
+    unsigned int v;
+
+    if(!half)
+      v = (ins & 0x00400000) ? mem_rd(addr, 1) : mem_rd(addr, 4);
+    else switch((ins >> 5) & 3)
+    {
+    case 1: v = mem_rd(addr, 2); break;
+    case 2: v = (unsigned int)(int)(signed char)mem_rd(addr, 1); break;
+    default: v = (unsigned int)(int)(short)mem_rd(addr, 2); break;
+    }
+    armstsf_cycles += 3;
+    if(!pre || (ins & 0x00200000))
+      r[rn] = base + offset;
+    r[rd] = v;
+  }
+  else
+  {
+    unsigned int v = rd == 15 ? pc + 12 : r[rd];
+
+    if(!half)
+      mem_wr(addr, (ins & 0x00400000) ? 1 : 4, v);
+    else
+      mem_wr(addr, 2, v);
+    armstsf_cycles += 2;
+    if(!pre || (ins & 0x00200000))
+      r[rn] = base + offset;
+  }
+}
+
+static void block_transfer(unsigned int ins, unsigned int pc)
+{
+  unsigned int rn = (ins >> 16) & 15;
+  unsigned int list = ins & 0xFFFF;
+  unsigned int n = 0, i, addr, start;
+  int pre = ins & 0x01000000, up = ins & 0x00800000;
+
+  for(i = 0; i < 16; i++)
+    if(list & (1 << i))
+      n++;
+  if(!n || (ins & 0x00400000))
+    arm_fail("odd LDM/STM", pc);
+  start = up ? r[rn] : r[rn] - 4 * n;
+  addr = start;
+  if(pre == !!up)
+    addr += 4;
+  r[15] = pc + 4;
+
+  for(i = 0; i < 16; i++)
+  {
+    if(!(list & (1 << i)))
+      continue;
+    if(ins & 0x00100000)
+      r[i] = mem_rd(addr, 4);
+    else
+      mem_wr(addr, 4, r[i]);
+    addr += 4;
+  }
+  if(ins & 0x00200000)
+    r[rn] = up ? r[rn] + 4 * n : start;
+  armstsf_cycles += (ins & 0x00100000) ? n + 2 : n + 1;
+  if((ins & 0x00100000) && (list & 0x8000))
+    armstsf_cycles += 2;
+}
+
+static void arm_run(unsigned int entry)
+{
+  unsigned long steps = 0;
+
+  r[15] = entry;
+  while(r[15] != RETURN_ADDR)
+  {
+    unsigned int pc = r[15];
+    unsigned int ins;
+
+    if(pc >= CODE_MAX || (pc & 3))
+      arm_fail("jump out of stsf.s", pc);
+    if(++steps > 1000000)
+      arm_fail("runaway", pc);
+    ins = mem_rd(pc, 4);
+    if(!cond_passed(ins))
+    {
+      r[15] = pc + 4;
+      armstsf_cycles++;
+      continue;
+    }
+
+    if((ins & 0x0FFFFFF0) == 0x012FFF10)
+    {
+      r[15] = r[ins & 15] & ~1;
+      armstsf_cycles += 3;
+    }
+    else if((ins & 0x0E000000) == 0x0A000000)
+    {
+      int off = (int)(ins << 8) >> 6;
+
+      if(ins & 0x01000000)
+        r[14] = pc + 4;
+      r[15] = pc + 8 + off;
+      armstsf_cycles += 3;
+    }
+    else if((ins & 0x0FC000F0) == 0x00000090)
+      multiply(ins, pc);
+    else if((ins & 0x0E000090) == 0x00000090 && (ins & 0x60))
+      transfer(ins, pc, 1);
+    else if((ins & 0x0C000000) == 0x00000000)
+      data_processing(ins, pc);
+    else if((ins & 0x0C000000) == 0x04000000)
+      transfer(ins, pc, 0);
+    else if((ins & 0x0E000000) == 0x08000000)
+      block_transfer(ins, pc);
+    else
+      arm_fail("unknown instruction", pc);
+  }
+}
+
+/* gsm_stsf_arm() **************
+   Copies the filter state and samples into the interpreter's memory,
+   runs stsf.s, and copies the results back.
+*/
+void gsm_stsf_arm(word *v, const word *rrp, int k,
+                  const word *wt, word *sr)
+{
+  unsigned int sr_addr = wt == sr ? WT_ADDR : SR_ADDR;
+  unsigned int i;
+
+  if(!code_loaded)
+    load_code();
+  if(k < 1 || k > 160)
+    arm_fail("bad sample count", k);
+
+  for(i = 0; i < 9; i++)
+    mem_wr(V_ADDR + 2 * i, 2, (unsigned short)v[i]);
+  for(i = 0; i < 8; i++)
+    mem_wr(RRP_ADDR + 2 * i, 2, (unsigned short)rrp[i]);
+  for(i = 0; i < (unsigned int)k; i++)
+    mem_wr(WT_ADDR + 2 * i, 2, (unsigned short)wt[i]);
+
+  /* AAPCS: four arguments in r0-r3, the fifth on the stack; the
+     callee-saved registers get values it has to put back */
+  for(i = 0; i < 13; i++)
+    r[i] = 0x5A5A0000 + i;
+  r[0] = V_ADDR;
+  r[1] = RRP_ADDR;
+  r[2] = k;
+  r[3] = WT_ADDR;
+  r[13] = SP_ADDR;
+  r[14] = RETURN_ADDR;
+  mem_wr(SP_ADDR, 4, sr_addr);
+
+  arm_run(0);
+
+  if(r[13] != SP_ADDR)
+    arm_fail("sp not restored", r[13]);
+  for(i = 4; i < 12; i++)
+    if(r[i] != 0x5A5A0000 + i)
+      arm_fail("callee-saved register not restored", i);
+
+  for(i = 0; i < 9; i++)
+    v[i] = (short)mem_rd(V_ADDR + 2 * i, 2);
+  for(i = 0; i < (unsigned int)k; i++)
+    sr[i] = (short)mem_rd(sr_addr + 2 * i, 2);
+}
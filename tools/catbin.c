@@ -60,25 +60,65 @@ Why not require the full Cygwin distribution?
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 const char syntax_help[] =
-"catbin 0.1 by Damian Yerrick: concatenates binary files\n"
-"usage: catbin INFILE [INFILE...] OUTFILE\n";
+"catbin 0.2: concatenates binary files\n"
+"usage: catbin [-g] INFILE [INFILE...] OUTFILE\n"
+"-g: the first INFILE is a GBA ROM; record where the first GBFS\n"
+"    file starts in its header so that the player need not search\n";
+
+static const char GBFS_magic[] = "PinEightGBFS\r\n\032\n";
+
+/* offset in the GBA cartridge header of 4 reserved bytes that get the
+   GBFS file's offset, and of the header checksum that covers them */
+#define HEADER_GBFS_OFF 0xb8
+#define HEADER_CHECKSUM 0xbd
+
+/* record_gbfs() ***********************
+   Writes gbfs_off into the ROM header at the start of fp and fixes
+   the header checksum.  Returns 0 on success.
+*/
+static int record_gbfs(FILE *fp, unsigned long gbfs_off)
+{
+  unsigned char header[HEADER_CHECKSUM + 1];
+  unsigned int i, sum = 0;
+
+  rewind(fp);
+  if(fread(header, sizeof(header), 1, fp) != 1)
+    return -1;
+  for(i = 0; i < 4; i++)
+    header[HEADER_GBFS_OFF + i] = gbfs_off >> (i * 8);
+  for(i = 0xa0; i < HEADER_CHECKSUM; i++)
+    sum += header[i];
+  header[HEADER_CHECKSUM] = -(sum + 0x19);
+
+  fseek(fp, HEADER_GBFS_OFF, SEEK_SET);
+  return fwrite(header + HEADER_GBFS_OFF,
+                HEADER_CHECKSUM + 1 - HEADER_GBFS_OFF, 1, fp) != 1;
+}
 
 int main(int argc, char **argv)
 {
   char buf[1024];
   size_t n_got;
-  int arg;
+  int arg, first_arg = 1, first_read;
+  int want_gbfs = 0;
+  unsigned long out_len = 0, gbfs_off = 0;
   FILE *infile, *outfile;
 
-  if(argc < 3)
+  if(argc > 1 && !strcmp(argv[1], "-g"))
+    {
+      want_gbfs = 1;
+      first_arg = 2;
+    }
+  if(argc < first_arg + 2)
     {
       fputs(syntax_help, stderr);
       return 1;
     }
 
-  outfile = fopen(argv[argc - 1], "wb");
+  outfile = fopen(argv[argc - 1], "wb+");
   if(!outfile)
     {
       fputs("catbin could not open output file ", stderr);
@@ -86,7 +126,7 @@ int main(int argc, char **argv)
       return 1;
     }
 
-  for(arg = 1; arg < argc - 1; arg++)
+  for(arg = first_arg; arg < argc - 1; arg++)
     {
       infile = fopen(argv[arg], "rb");
       if(!infile)
@@ -96,10 +136,18 @@ int main(int argc, char **argv)
 	  perror(argv[arg]);
 	  return 1;
 	}
+      first_read = 1;
       while((n_got = fread(buf, sizeof(char), sizeof(buf), infile)) > 0)
 	{
 	  size_t n_written;
 
+	  /* only the start of an INFILE can be a GBFS file's start */
+	  if(want_gbfs && first_read && !gbfs_off && arg > first_arg
+	     && n_got >= 16 && !memcmp(buf, GBFS_magic, 16))
+	    gbfs_off = out_len;
+	  first_read = 0;
+	  out_len += n_got;
+
 	  n_written = fwrite(buf, sizeof(char), n_got, outfile);
 	  if(n_written < n_got)
 	    {
@@ -112,6 +160,21 @@ int main(int argc, char **argv)
 	      return 1;
 	    }
 	}
+      fclose(infile);
+    }
+
+  if(want_gbfs)
+    {
+      if(!gbfs_off)
+	fputs("catbin: warning: no GBFS file at the start of an INFILE\n",
+	      stderr);
+      else if(record_gbfs(outfile, gbfs_off))
+	{
+	  fclose(outfile);
+	  fputs("catbin could not record GBFS offset in ", stderr);
+	  perror(argv[argc - 1]);
+	  return 1;
+	}
     }
 
   fclose(outfile);
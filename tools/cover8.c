@@ -0,0 +1,247 @@
+/* cover8.c
+   quantize a mode 3 cover to a mode 4 cover
+
+Copyright 2026 GBAWAVE contributors
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+
+*/
+
+/* Reads a 240x160 RGB15 little-endian bitmap, the kind the player
+   shows in mode 3, and writes a paletted cover for mode 4: 256
+   palette entries in RGB15, then 38400 bytes of pixels.  Name the
+   output palSONG for tools/gbfs.
+
+   The palette comes from median cut over the image's colors.  It
+   has at most COVER_COLORS entries, because the player keeps the
+   last two for the progress bar.  Each pixel gets the nearest
+   entry, without dithering.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COVER_W 240
+#define COVER_H 160
+#define COVER_COLORS 254
+
+static const char help_text[] =
+"Quantizes a 240x160 RGB15 cover to 254 colors for mode 4.\n"
+"usage: cover8 INFILE OUTFILE\n";
+
+struct BOX
+{
+  unsigned int first, n;  /* range of colors[] */
+  unsigned long pop;      /* pixels in it */
+  unsigned int range;     /* widest of its r, g, b extents */
+  unsigned int axis;      /* shift of that component */
+};
+
+static unsigned long hist[32768];
+static unsigned short colors[32768];
+static unsigned int sort_axis;
+
+static unsigned int comp(unsigned int c, unsigned int shift)
+{
+  return (c >> shift) & 31;
+}
+
+static int cmp_axis(const void *a, const void *b)
+{
+  return (int)comp(*(const unsigned short *)a, sort_axis)
+         - (int)comp(*(const unsigned short *)b, sort_axis);
+}
+
+/* measure a box's population and its widest component */
+static void box_stats(struct BOX *b)
+{
+  unsigned int lo[3] = {31, 31, 31}, hi[3] = {0, 0, 0};
+  unsigned int i, k;
+
+  b->pop = 0;
+  for(i = b->first; i < b->first + b->n; i++)
+  {
+    b->pop += hist[colors[i]];
+    for(k = 0; k < 3; k++)
+    {
+      unsigned int v = comp(colors[i], k * 5);
+
+      if(v < lo[k])
+        lo[k] = v;
+      if(v > hi[k])
+        hi[k] = v;
+    }
+  }
+  b->range = 0;
+  b->axis = 0;
+  for(k = 0; k < 3; k++)
+    if(hi[k] - lo[k] > b->range)
+    {
+      b->range = hi[k] - lo[k];
+      b->axis = k * 5;
+    }
+}
+
+/* median_cut() ************************
+   Splits the n_colors distinct colors into up to COVER_COLORS boxes
+   and returns how many.
+*/
+static unsigned int median_cut(struct BOX *boxes, unsigned int n_colors)
+{
+  unsigned int n_boxes = 1;
+
+  boxes[0].first = 0;
+  boxes[0].n = n_colors;
+  box_stats(&boxes[0]);
+
+  while(n_boxes < COVER_COLORS)
+  {
+    struct BOX *b = NULL, *nb = boxes + n_boxes;
+    unsigned long half, acc = 0;
+    unsigned int i, split;
+
+    /* split the most populous box that still has two colors */
+    for(i = 0; i < n_boxes; i++)
+      if(boxes[i].n > 1 && (!b || boxes[i].pop > b->pop))
+        b = boxes + i;
+    if(!b)
+      break;
+
+    sort_axis = b->axis;
+    qsort(colors + b->first, b->n, sizeof(colors[0]), cmp_axis);
+    half = b->pop / 2;
+    for(split = 1; split < b->n - 1; split++)
+    {
+      acc += hist[colors[b->first + split - 1]];
+      if(acc >= half)
+        break;
+    }
+
+    nb->first = b->first + split;
+    nb->n = b->n - split;
+    b->n = split;
+    box_stats(b);
+    box_stats(nb);
+    n_boxes++;
+  }
+  return n_boxes;
+}
+
+static void fputi16(unsigned int in, FILE *fp)
+{
+  fputc(in, fp);
+  fputc(in >> 8, fp);
+}
+
+int main(int argc, char **argv)
+{
+  static unsigned short pixels[COVER_W * COVER_H];
+  static unsigned char index_of[32768];
+  struct BOX boxes[COVER_COLORS];
+  unsigned short pal[256] = {0};
+  unsigned int n_colors = 0, n_boxes, i, k;
+  FILE *fp;
+
+  if(argc != 3)
+  {
+    fputs(help_text, stderr);
+    return 1;
+  }
+
+  fp = fopen(argv[1], "rb");
+  if(!fp)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  for(i = 0; i < COVER_W * COVER_H; i++)
+  {
+    int lo = fgetc(fp);
+    int hi = fgetc(fp);
+
+    if(hi == EOF)
+    {
+      fprintf(stderr, "%s: not a 240x160 RGB15 image\n", argv[1]);
+      fclose(fp);
+      return 1;
+    }
+    pixels[i] = (lo | hi << 8) & 0x7FFF;
+    hist[pixels[i]]++;
+  }
+  fclose(fp);
+
+  for(i = 0; i < 32768; i++)
+    if(hist[i])
+      colors[n_colors++] = i;
+  n_boxes = median_cut(boxes, n_colors);
+
+  /* each entry is its box's mean, weighted by pixel count */
+  for(i = 0; i < n_boxes; i++)
+  {
+    unsigned long sum[3] = {0, 0, 0};
+    unsigned int j;
+
+    for(j = boxes[i].first; j < boxes[i].first + boxes[i].n; j++)
+      for(k = 0; k < 3; k++)
+        sum[k] += comp(colors[j], k * 5) * hist[colors[j]];
+    for(k = 0; k < 3; k++)
+      pal[i] |= ((sum[k] + boxes[i].pop / 2) / boxes[i].pop) << (k * 5);
+  }
+
+  /* map each color to the nearest entry */
+  for(i = 0; i < n_colors; i++)
+  {
+    unsigned int c = colors[i], best = 0;
+    unsigned long best_d = ~0UL;
+
+    for(k = 0; k < n_boxes; k++)
+    {
+      long dr = (long)comp(c, 0) - (long)comp(pal[k], 0);
+      long dg = (long)comp(c, 5) - (long)comp(pal[k], 5);
+      long db = (long)comp(c, 10) - (long)comp(pal[k], 10);
+      unsigned long d = dr * dr + dg * dg + db * db;
+
+      if(d < best_d)
+      {
+        best_d = d;
+        best = k;
+      }
+    }
+    index_of[c] = best;
+  }
+
+  fp = fopen(argv[2], "wb");
+  if(!fp)
+  {
+    perror(argv[2]);
+    return 1;
+  }
+  for(i = 0; i < 256; i++)
+    fputi16(pal[i], fp);
+  for(i = 0; i < COVER_W * COVER_H; i++)
+    fputc(index_of[pixels[i]], fp);
+  fclose(fp);
+
+  printf("%s: %u colors in %u palette entries\n",
+         argv[1], n_colors, n_boxes);
+  return 0;
+}
@@ -0,0 +1,188 @@
+/* dithspec.c
+   measure the noise that narrowing to 8 bits adds
+
+Copyright 2026 GBAWAVE contributors.
+See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+
+*/
+
+/* This runs a sine wave through the player's own
+   gsm_postprocess_s8() on the PC and reports the spectrum of
+   everything in the 8-bit output that isn't the tone or its 2:1
+   image.  The makefile builds it once per GSM_DITHER setting:
+
+     dithspec0 -40
+     dithspec1 -40
+     dithspec2 -40
+
+   The tone is placed on an FFT bin so that it and its image can be
+   removed exactly, which leaves truncation noise, dither, and any
+   distortion.  Levels are in dB relative to a full-scale sine.
+
+   It also times gsm_postprocess_s8() and prints nanoseconds per
+   output byte on this PC.  That only means something next to the
+   other builds' figures; the ARM7 cycle counts are in gsmcode.c.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../private.h"
+#include "../gsm.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define FS_IN 18157	/* decoder rate in the player */
+#define FFT_LEN 65536	/* output bytes analyzed */
+#define CHUNK 304	/* input samples per video frame */
+#define N_BANDS 18	/* 1 kHz each, up to FS_IN */
+
+static const char help_text[] =
+"Measures 8-bit output noise of the GSM player's postprocessing.\n"
+"usage: dithspec [LEVEL_DB [FREQ_HZ]]\n"
+"LEVEL_DB: output tone level re full scale (default -40)\n"
+"FREQ_HZ: tone frequency (default 440)\n";
+
+static double re[FFT_LEN], im[FFT_LEN];
+
+/* in-place radix-2 FFT of re[] and im[] */
+static void fft(void)
+{
+  unsigned int i, j, len;
+
+  for(i = 1, j = 0; i < FFT_LEN; i++)
+  {
+    unsigned int bit = FFT_LEN >> 1;
+
+    for(; j & bit; bit >>= 1)
+      j ^= bit;
+    j |= bit;
+    if(i < j)
+    {
+      double t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+
+  for(len = 2; len <= FFT_LEN; len <<= 1)
+  {
+    double ang = -2 * M_PI / len;
+
+    for(i = 0; i < FFT_LEN; i += len)
+      for(j = 0; j < len / 2; j++)
+      {
+        double wr = cos(ang * j), wi = sin(ang * j);
+        double *ar = re + i + j, *ai = im + i + j;
+        double br = ar[len / 2] * wr - ai[len / 2] * wi;
+        double bi = ar[len / 2] * wi + ai[len / 2] * wr;
+
+        ar[len / 2] = *ar - br;
+        ai[len / 2] = *ai - bi;
+        *ar += br;
+        *ai += bi;
+      }
+  }
+}
+
+static double db(double power)
+{
+  /* a full-scale 8-bit sine has power 128^2 / 2 */
+  return power > 0 ? 10 * log10(power / (128.0 * 128.0 / 2)) : -999;
+}
+
+int main(int argc, char **argv)
+{
+  double level = -40, freq = 440, amp, w, tone = 0;
+  static gsm_signal in[FFT_LEN / 2];
+  static signed char out[FFT_LEN];
+  double bands[N_BANDS] = {0}, total = 0, speech = 0;
+  struct gsm_state st;
+  unsigned int i, k, reps;
+  clock_t t0;
+
+  if(argc > 3)
+  {
+    fputs(help_text, stderr);
+    return 1;
+  }
+  if(argc > 1)
+    level = atof(argv[1]);
+  if(argc > 2)
+    freq = atof(argv[2]);
+
+  /* put the tone on bin k so it repeats exactly every FFT_LEN bytes */
+  k = (unsigned int)(freq * FFT_LEN / (2.0 * FS_IN) + 0.5);
+  if(k < 1 || k >= FFT_LEN / 4)
+  {
+    fputs("dithspec: frequency out of range\n", stderr);
+    return 1;
+  }
+  /* undo the gain of the de-emphasis and the doubling after it,
+     2 / |1 - (28180 / 32768) e^-jw|, so that LEVEL_DB is what
+     comes out */
+  w = 2 * M_PI * k / (FFT_LEN / 2);
+  amp = 32767 * pow(10, level / 20)
+        * hypot(1 - 28180 / 32768.0 * cos(w), 28180 / 32768.0 * sin(w)) / 2;
+  for(i = 0; i < FFT_LEN / 2; i++)
+    in[i] = (gsm_signal)floor(amp * sin(2 * M_PI * k * i / (FFT_LEN / 2)) + 0.5);
+
+  /* one pass to settle the de-emphasis and the upsampler,
+     then one to keep */
+  memset(&st, 0, sizeof(st));
+  for(reps = 0; reps < 2; reps++)
+    for(i = 0; i < FFT_LEN / 2; i += CHUNK)
+    {
+      unsigned int n = FFT_LEN / 2 - i;
+
+      if(n > CHUNK)
+        n = CHUNK;
+      gsm_postprocess_s8(&st, in + i, n, out + 2 * i);
+    }
+
+  for(i = 0; i < FFT_LEN; i++)
+  {
+    re[i] = out[i];
+    im[i] = 0;
+  }
+  fft();
+
+  /* one-sided power per bin, skipping DC, the tone, and its image */
+  for(i = 1; i < FFT_LEN / 2; i++)
+  {
+    double p = 2 * (re[i] * re[i] + im[i] * im[i])
+               / ((double)FFT_LEN * FFT_LEN);
+    double hz = i * (2.0 * FS_IN) / FFT_LEN;
+
+    if(i == k)
+      tone = p;
+    if(i == k || i == FFT_LEN / 2 - k)
+      continue;
+    total += p;
+    if(hz < FS_IN / 4)
+      speech += p;
+    if(hz < N_BANDS * 1000)
+      bands[(unsigned int)(hz / 1000)] += p;
+  }
+
+  printf("tone %.1f Hz at %.1f dB, output rate %d Hz\n",
+         k * (2.0 * FS_IN) / FFT_LEN, db(tone), 2 * FS_IN);
+  for(i = 0; i < N_BANDS; i++)
+    printf("%2u-%2u kHz: %7.1f dB\n", i, i + 1, db(bands[i]));
+  printf("noise below %d Hz: %.1f dB\n", FS_IN / 4, db(speech));
+  printf("noise total: %.1f dB\n", db(total));
+
+  t0 = clock();
+  for(reps = 0; reps < 200; reps++)
+    for(i = 0; i + CHUNK <= FFT_LEN / 2; i += CHUNK)
+      gsm_postprocess_s8(&st, in + i, CHUNK, out + 2 * i);
+  printf("host time: %.2f ns per output byte\n",
+         (clock() - t0) * 1e9 / CLOCKS_PER_SEC
+         / (200.0 * (FFT_LEN / 2 / CHUNK) * CHUNK * 2));
+  return 0;
+}
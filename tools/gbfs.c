@@ -48,12 +48,19 @@ typedef unsigned short u16;
 typedef unsigned long u32;  /* this needs to be changed on 64-bit systems */
 
 #include "../gbfs.h"
+#include "../private.h"
+#include "../gsm.h"
+
+/* frames between seek table snapshots; 256 frames at the player's
+   18157 Hz is about 2.3 seconds */
+#define SEEK_INTERVAL 256
 
 static const char GBFS_magic[] = "PinEightGBFS\r\n\032\n";
 
 static const char help_text[] =
 "Creates a GBFS archive.\n"
-"usage: gbfs ARCHIVE [FILE...]\n";
+"usage: gbfs [-i] ARCHIVE [FILE...]\n"
+"-i: add a name index so that lookups needn't binary search\n";
 
 GBFS_FILE header;
 GBFS_ENTRY *entries;
@@ -98,6 +105,285 @@ void fputi32(unsigned long in, FILE *f)
 }
 
 
+/* is_gsm_name() ***********************
+   true if a file name ends in .gsm, in any case
+*/
+int is_gsm_name(const char *name)
+{
+  size_t len = strlen(name);
+  const char *ext = name + len - 4;
+
+  return len >= 4 && ext[0] == '.'
+         && (ext[1] | 0x20) == 'g'
+         && (ext[2] | 0x20) == 's'
+         && (ext[3] | 0x20) == 'm';
+}
+
+
+/* is_cover_name() *********************
+   true if a file name starts with img (a mode 3 bitmap) or pal (a
+   mode 4 bitmap from cover8) and the rest of it names one of the
+   n_inputs files in inputs.  This is the player's own test in
+   tracks_init(), so a song such as palace.gsm stays a song.
+*/
+int is_cover_name(const char *name, char **inputs, unsigned int n_inputs)
+{
+  unsigned int i;
+
+  if(strncmp(name, "img", 3) && strncmp(name, "pal", 3))
+    return 0;
+  for(i = 0; i < n_inputs; i++)
+    if(!strcmp(basename(inputs[i]), name + 3))
+      return 1;
+  return 0;
+}
+
+/* size of the palette that leads a pal cover; it stays raw so that
+   the player can load it while the pixels are still coming */
+#define COVER_PAL_LEN 512
+
+
+/* lz77_compress() *********************
+   Compresses len bytes at src into dst in the format of the GBA
+   BIOS LZ77 functions and returns the compressed length, padded to
+   a multiple of 4.  dst needs room for len + len / 8 + 8 bytes.
+   Copies never reach back only 1 byte, so the result is also safe
+   for LZ77UnCompVram.
+*/
+#define LZ_HASH_BITS 12
+#define LZ_MAX_DIST 4096
+#define LZ_MAX_RUN 18
+#define LZ_MAX_CHAIN 256
+
+static unsigned long lz_hash(const unsigned char *p)
+{
+  return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & ((1 << LZ_HASH_BITS) - 1);
+}
+
+unsigned long lz77_compress(unsigned char *dst,
+                            const unsigned char *src, unsigned long len)
+{
+  long head[1 << LZ_HASH_BITS];
+  long *prev = malloc(len * sizeof(long));
+  unsigned long i = 0, out = 4, k;
+
+  if(!prev)
+    return 0;
+  for(k = 0; k < 1 << LZ_HASH_BITS; k++)
+    head[k] = -1;
+
+  dst[0] = 0x10;
+  dst[1] = len;
+  dst[2] = len >> 8;
+  dst[3] = len >> 16;
+
+  while(i < len)
+  {
+    unsigned long flag_pos = out++;
+    unsigned int bit;
+
+    dst[flag_pos] = 0;
+    for(bit = 0; bit < 8 && i < len; bit++)
+    {
+      unsigned long best_len = 0, best_dist = 0, run = 1;
+      long p;
+      unsigned int chain = 0;
+
+      if(i + 3 <= len)
+        for(p = head[lz_hash(src + i)];
+            p >= 0 && i - p <= LZ_MAX_DIST && chain < LZ_MAX_CHAIN;
+            p = prev[p], chain++)
+        {
+          unsigned long n = 0;
+
+          if(i - p < 2)
+            continue;
+          while(n < LZ_MAX_RUN && i + n < len && src[p + n] == src[i + n])
+            n++;
+          if(n > best_len)
+          {
+            best_len = n;
+            best_dist = i - p;
+            if(n == LZ_MAX_RUN)
+              break;
+          }
+        }
+
+      if(best_len >= 3)
+      {
+        dst[flag_pos] |= 0x80 >> bit;
+        dst[out++] = ((best_len - 3) << 4) | ((best_dist - 1) >> 8);
+        dst[out++] = best_dist - 1;
+        run = best_len;
+      }
+      else
+        dst[out++] = src[i];
+
+      /* hash every position passed over */
+      for(; run > 0; run--, i++)
+        if(i + 3 <= len)
+        {
+          unsigned long h = lz_hash(src + i);
+
+          prev[i] = head[h];
+          head[h] = i;
+        }
+    }
+  }
+
+  while(out & 3)
+    dst[out++] = 0;
+  free(prev);
+  return out;
+}
+
+
+/* write_cover() ***********************
+   Copies a cover image from src to dst, LZ77 compressed if that
+   makes it smaller.  A pal cover's palette is left as it is and
+   only its pixels are compressed.  Returns the length written and
+   sets *packed to whether it was compressed.
+*/
+unsigned long write_cover(FILE *dst, FILE *src, int paletted, int *packed)
+{
+  unsigned long len, clen = 0, skip = paletted ? COVER_PAL_LEN : 0;
+  unsigned char *raw, *comp;
+
+  *packed = 0;
+  fseek(src, 0, SEEK_END);
+  len = ftell(src);
+  rewind(src);
+  raw = malloc(len + 1);
+  comp = malloc(len + len / 8 + 8);
+  if(!raw || !comp || fread(raw, 1, len, src) != len)
+  {
+    free(raw);
+    free(comp);
+    rewind(src);
+    return fcopy(dst, src);
+  }
+
+  if(len > skip && len - skip < 0x1000000)
+    clen = lz77_compress(comp, raw + skip, len - skip);
+  if(clen > 0 && skip + clen < len)
+  {
+    fwrite(raw, 1, skip, dst);
+    fwrite(comp, 1, clen, dst);
+    len = skip + clen;
+    *packed = 1;
+  }
+  else
+    fwrite(raw, 1, len, dst);
+  free(raw);
+  free(comp);
+  return len;
+}
+
+
+/* append_seek_table() *****************
+   Decodes the GSM song just copied from src, and appends a snapshot
+   of the decoder state every SEEK_INTERVAL frames plus the trailer
+   described in private.h, so that the player can seek without
+   clicks.  Returns the new length of the object.
+*/
+unsigned long append_seek_table(FILE *dst, FILE *src, unsigned long flen)
+{
+  struct gsm_state st;
+  struct gsm_snapshot snap;
+  gsm_frame frame;
+  gsm_signal pcm[160];
+  unsigned long frames_len = flen;
+  unsigned long n_frames = flen / sizeof(gsm_frame);
+  unsigned long table_off, i;
+
+  /* nothing to skip to */
+  if(n_frames <= SEEK_INTERVAL)
+    return flen;
+
+  while(flen & 3)
+  {
+    fputc(0, dst);
+    flen++;
+  }
+  table_off = flen;
+
+  memset(&st, 0, sizeof(st));
+  st.nrp = 40;
+  rewind(src);
+  for(i = 0; i < n_frames; i++)
+  {
+    if(i > 0 && i % SEEK_INTERVAL == 0)
+    {
+      const word *w = (const word *)&snap;
+      unsigned int k;
+
+      gsm_snapshot_save(&st, &snap);
+      for(k = 0; k < sizeof(snap) / sizeof(word); k++)
+        fputi16(w[k] & 0xFFFF, dst);
+      flen += sizeof(snap);
+    }
+    if(fread(frame, sizeof(frame), 1, src) != 1)
+      break;
+    gsm_decode(&st, frame, pcm);
+  }
+
+  fputi32(frames_len, dst);
+  fputi32(table_off, dst);
+  fputi32(SEEK_INTERVAL, dst);
+  fputi32(GSM_SEEK_MAGIC, dst);
+  return flen + GSM_SEEK_TRAILER_LEN;
+}
+
+
+/* write_hash_index() ******************
+   Appends the name index described in gbfs.h for the sorted
+   directory, and sets header.hash_off and header.hash_nmemb.
+*/
+void write_hash_index(FILE *dst, unsigned int n_entries)
+{
+  unsigned int n_slots = 4, i;
+  unsigned short *slots;
+
+  /* slot counts have to fit in hash_nmemb */
+  if(n_entries > 16384)
+  {
+    fputs("too many files for a name index; leaving it out\n", stderr);
+    return;
+  }
+  while(n_slots < 2 * n_entries)
+    n_slots <<= 1;
+  slots = calloc(n_slots, sizeof(slots[0]));
+  if(!slots)
+  {
+    fputs("not enough memory for name index; leaving it out\n", stderr);
+    return;
+  }
+
+  for(i = 0; i < n_entries; i++)
+  {
+    unsigned long h = GBFS_FNV_BASIS;
+    unsigned int k;
+
+    for(k = 0; k < 24 && entries[i].name[k]; k++)
+    {
+      h ^= (unsigned char)entries[i].name[k];
+      h = (h * GBFS_FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+    for(k = h & (n_slots - 1); slots[k]; k = (k + 1) & (n_slots - 1))
+      ;
+    slots[k] = i + 1;
+  }
+
+  while(ftell(dst) & 3)
+    fputc(0, dst);
+  header.hash_off = ftell(dst);
+  header.hash_nmemb = n_slots;
+  for(i = 0; i < n_slots; i++)
+    fputi16(slots[i], dst);
+  free(slots);
+}
+
+
 /* namecmp() ***************************
    compares the first 24 bytes of a pair of strings.
    useful for sorting names.
@@ -114,7 +400,15 @@ int main(int argc, char **argv)
   FILE *outfile;
   unsigned int arg = 2;
   unsigned int n_entries = 0;
+  unsigned long n_covers = 0, cover_raw = 0, cover_stored = 0;
+  int want_index = 0;
 
+  if(argc > 1 && !strcmp(argv[1], "-i"))
+  {
+    want_index = 1;
+    argc--;
+    argv++;
+  }
   if(argc < 3)
   {
     fputs(help_text, stderr);
@@ -149,6 +443,7 @@ int main(int argc, char **argv)
   {
     FILE *infile;
     unsigned long flen;
+    int packed = 0;
 
     infile = fopen(argv[arg], "rb");
     if(!infile)
@@ -165,13 +460,33 @@ int main(int argc, char **argv)
     entries[n_entries].data_offset = ftell(outfile);
 
     /* copy the file into the data area */
-    flen = fcopy(outfile, infile);
+    if(is_cover_name(basename(argv[arg]), argv + 2, argc - 2))
+    {
+      unsigned long raw_len;
+
+      fseek(infile, 0, SEEK_END);
+      raw_len = ftell(infile);
+      rewind(infile);
+      flen = write_cover(outfile, infile,
+                         basename(argv[arg])[0] == 'p', &packed);
+      n_covers++;
+      cover_raw += raw_len;
+      cover_stored += flen;
+    }
+    else
+    {
+      flen = fcopy(outfile, infile);
+      if(is_gsm_name(argv[arg]))
+        flen = append_seek_table(outfile, infile, flen);
+    }
     entries[n_entries].len = flen;
 
-    /* copy name */
+    /* copy name; a compressed cover is imz or paz */
     strncpy(entries[n_entries].name,
             basename(argv[arg]),
             sizeof(entries[n_entries].name));
+    if(packed)
+      entries[n_entries].name[2] = 'z';
 
     /* diagnostic */
     {
@@ -194,17 +509,28 @@ int main(int argc, char **argv)
     arg++;
   }
 
+  /* sort directory by name */
+  qsort(entries, n_entries, sizeof(entries[0]), namecmp);
+
+  if(want_index && n_entries > 0)
+    write_hash_index(outfile, n_entries);
+
   header.total_len = ftell(outfile);
   rewind(outfile);
 
-  /* sort directory by name */
-  qsort(entries, n_entries, sizeof(entries[0]), namecmp);
+  if(n_covers > 0)
+    printf("%lu covers: %lu bytes raw, %lu stored (%lu%%)\n",
+           n_covers, cover_raw, cover_stored,
+           cover_raw ? cover_stored * 100 / cover_raw : 0);
+  printf("%10lu bytes total\n", (unsigned long)header.total_len);
 
   /* write header */
   fwrite(GBFS_magic, 16, 1, outfile);
   fputi32(header.total_len, outfile);
   fputi16(header.dir_off, outfile);
   fputi16(n_entries, outfile);
+  fputi32(header.hash_off, outfile);
+  fputi16(header.hash_nmemb, outfile);
 
   
   /* write directory */
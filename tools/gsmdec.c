@@ -0,0 +1,102 @@
+/* gsmdec.c
+   decode a GSM file to raw PCM on the host
+
+Copyright 2026 GBAWAVE contributors.
+See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+
+*/
+
+/* This runs the player's own gsmcode.c on the PC, so you can compare
+   a GSM_FAST build of the decoder against the exact one:
+
+     gsmdec song.gsm exact.pcm
+     gsmdec-fast song.gsm fast.pcm
+     pcmsnr exact.pcm fast.pcm
+
+   or the C short term synthesis filter against stsf.s, which
+   gsmdec-arm runs in the ARM interpreter in armstsf.c:
+
+     gsmdec song.gsm c.pcm
+     gsmdec-arm song.gsm arm.pcm
+     cmp c.pcm arm.pcm
+
+   gsmdec-arm also prints the cycles stsf.s took per frame.
+
+   Output is signed 16-bit little-endian mono at 8000 Hz.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../private.h"
+#include "../gsm.h"
+
+#ifdef GSM_STSF_ASM
+extern unsigned long armstsf_cycles;
+#endif
+
+static const char help_text[] =
+"Decodes a GSM 06.10 file to signed 16-bit little-endian PCM.\n"
+"usage: gsmdec INFILE OUTFILE\n";
+
+int main(int argc, char **argv)
+{
+  FILE *infile, *outfile;
+  struct gsm_state decoder;
+  gsm_frame frame;
+  gsm_signal samples[160];
+  unsigned long n_frames = 0, n_bad = 0;
+
+  if(argc != 3)
+  {
+    fputs(help_text, stderr);
+    return 1;
+  }
+
+  infile = fopen(argv[1], "rb");
+  if(!infile)
+  {
+    fputs("gsmdec could not open input file ", stderr);
+    perror(argv[1]);
+    return 1;
+  }
+  outfile = fopen(argv[2], "wb");
+  if(!outfile)
+  {
+    fclose(infile);
+    fputs("gsmdec could not open output file ", stderr);
+    perror(argv[2]);
+    return 1;
+  }
+
+  memset(&decoder, 0, sizeof(decoder));
+  decoder.nrp = 40;
+
+  while(fread(frame, sizeof(frame), 1, infile) == 1)
+  {
+    unsigned int i;
+
+    if(gsm_decode(&decoder, frame, samples))
+      n_bad++;
+    for(i = 0; i < 160; i++)
+    {
+      fputc(samples[i] & 0xFF, outfile);
+      fputc((samples[i] >> 8) & 0xFF, outfile);
+    }
+    n_frames++;
+  }
+
+  fclose(infile);
+  fclose(outfile);
+  if(n_bad)
+    fprintf(stderr, "gsmdec: %lu of %lu frames had a bad magic number\n",
+            n_bad, n_frames);
+#ifdef GSM_STSF_ASM
+  if(n_frames)
+    fprintf(stderr, "stsf.s: %lu frames, %lu cycles per frame\n",
+            n_frames, armstsf_cycles / n_frames);
+#endif
+  return 0;
+}
@@ -0,0 +1,709 @@
+/* gsmtest.c
+   check the tuned decoder against the reference arithmetic
+
+Copyright 2026 GBAWAVE contributors.
+Based on GSM RPE-LTP 1.0.10, Copyright 1992-1994 by Jutta Degener
+and Carsten Bormann, Technische Universitaet Berlin.
+See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+
+*/
+
+/* This includes gsmcode.c itself so that it can reach the static
+   functions and tables, and holds copies of the routines they
+   replaced as they were in GSM RPE-LTP 1.0.10.  Each test runs both
+   over every input it can take and prints the first mismatch:
+
+     gsmtest lar
+     gsmtest coef
+     gsmtest apcm
+     gsmtest post [FILE.gsm]
+     gsmtest unpack [N]
+
+   lar: lartab.h against 4.2.8 and 4.2.9.2, for every LARc code
+   coef: 4.2.9.1 interpolation and 4.2.9.2 for samples 0..39, with
+         plain adds and >>, against GSM_ADD() and the portable
+         SASR(), for every pair of consecutive LARc codes
+   apcm: Gsm_RPE_Decoding() against 4.2.15 .. 4.2.17, for every
+         xmaxc, Mc, and xMc
+   post: gsm_decode_raw() + gsm_postprocess_s8() against 4.3
+         Postprocessing and the old player's 2:1 upsampler, over
+         the frames in FILE.gsm or 2000 random frames
+   unpack: Unpack_frame() against the byte-at-a-time unpacker, over
+         every single-bit frame and N (20000) random frames
+
+   gsmtest exits with status 0 if every test passed.
+*/
+
+#include "../gsmcode.c"
+
+#include <string.h>
+
+static const char help_text[] =
+"Checks the tuned GSM decoder against the reference arithmetic.\n"
+"usage: gsmtest TEST\n"
+"TEST is one of: lar coef apcm post unpack\n";
+
+
+/* reference: LARc -> LARpp and LARp -> rp *************************/
+
+/* 4.2.8 */
+static void ref_Decoding_of_the_coded_Log_Area_Ratios(word *LARc,
+                                                      word *LARpp)
+{
+  register word	temp1;
+  register long	ltmp;	/* for GSM_ADD */
+
+#undef	STEP
+#define	STEP( B, MIC, INVA )	\
+		temp1    = GSM_ADD( *LARc++, MIC ) << 10;	\
+		temp1    = GSM_SUB( temp1, B << 1 );		\
+		temp1    = GSM_MULT_R( INVA, temp1 );		\
+		*LARpp++ = GSM_ADD( temp1, temp1 );
+
+  STEP(      0,  -32,  13107 );
+  STEP(      0,  -32,  13107 );
+  STEP(   2048,  -16,  13107 );
+  STEP(  -2560,  -16,  13107 );
+
+  STEP(     94,   -8,  19223 );
+  STEP(  -1792,   -8,  17476 );
+  STEP(   -341,   -4,  31454 );
+  STEP(  -1144,   -4,  29708 );
+#undef	STEP
+}
+
+/* 4.2.9.1, samples 40..159 */
+static void ref_Coefficients_40_159(word *LARpp_j, word *LARp)
+{
+  int i;
+
+  for (i = 1; i <= 8; i++, LARp++, LARpp_j++)
+    *LARp = *LARpp_j;
+}
+
+/* private.h's SASR() when >> isn't known to be arithmetic */
+#define REF_SASR(x, by)	((x) >= 0 ? (x) >> (by) : (~(-((x) + 1) >> (by))))
+
+/* 4.2.9.1, samples 0..39 */
+static void ref_Coefficients_0_12(word *LARpp_j_1, word *LARpp_j,
+                                  word *LARp)
+{
+  int 	i;
+  longword ltmp;
+
+  for (i = 1; i <= 8; i++, LARp++, LARpp_j_1++, LARpp_j++) {
+    *LARp = GSM_ADD( REF_SASR( *LARpp_j_1, 2 ), REF_SASR( *LARpp_j, 2 ));
+    *LARp = GSM_ADD( *LARp,  REF_SASR( *LARpp_j_1, 1));
+  }
+}
+
+static void ref_Coefficients_13_26(word *LARpp_j_1, word *LARpp_j,
+                                   word *LARp)
+{
+  int i;
+  longword ltmp;
+  for (i = 1; i <= 8; i++, LARpp_j_1++, LARpp_j++, LARp++) {
+    *LARp = GSM_ADD( REF_SASR( *LARpp_j_1, 1), REF_SASR( *LARpp_j, 1 ));
+  }
+}
+
+static void ref_Coefficients_27_39(word *LARpp_j_1, word *LARpp_j,
+                                   word *LARp)
+{
+  int i;
+  longword ltmp;
+
+  for (i = 1; i <= 8; i++, LARpp_j_1++, LARpp_j++, LARp++) {
+    *LARp = GSM_ADD( REF_SASR( *LARpp_j_1, 2 ), REF_SASR( *LARpp_j, 2 ));
+    *LARp = GSM_ADD( *LARp, REF_SASR( *LARpp_j, 1 ));
+  }
+}
+
+/* 4.2.9.2 */
+static void ref_LARp_to_rp(word *LARp)
+{
+  int i;
+  word temp;
+  longword ltmp;
+
+  for (i = 1; i <= 8; i++, LARp++) {
+    if (*LARp < 0) {
+      temp = *LARp == MIN_WORD ? MAX_WORD : -(*LARp);
+      *LARp = - ((temp < 11059) ? temp << 1
+		 : ((temp < 20070) ? temp + 11059
+		    :  GSM_ADD( temp >> 2, 26112 )));
+    } else {
+      temp  = *LARp;
+      *LARp =    (temp < 11059) ? temp << 1
+	: ((temp < 20070) ? temp + 11059
+	   :  GSM_ADD( temp >> 2, 26112 ));
+    }
+  }
+}
+
+
+/* reference: xmaxc, Mc, xMc -> erp ********************************/
+
+static word ref_asr(word a, int n)
+{
+  if (n >= 16) return -(a < 0);
+  if (n <= -16) return 0;
+  if (n < 0) return a << -n;
+
+#	ifdef	SASR
+  return a >> n;
+#	else
+  if (a >= 0) return a >> n;
+  else return -(word)( -(uword)a >> n );
+#	endif
+}
+
+static word ref_asl(word a, int n)
+{
+  if (n >= 16) return 0;
+  if (n <= -16) return -(a < 0);
+  if (n < 0) return ref_asr(a, -n);
+  return a << n;
+}
+
+/* 4.12.15 */
+static void ref_APCM_quantization_xmaxc_to_exp_mant(word xmaxc,
+                                                    word *exp_out,
+                                                    word *mant_out)
+{
+  word	exp, mant;
+
+  exp = 0;
+  if (xmaxc > 15) exp = SASR(xmaxc, 3) - 1;
+  mant = xmaxc - (exp << 3);
+
+  if (mant == 0) {
+    exp  = -4;
+    mant = 7;
+  }
+  else {
+    while (mant <= 7) {
+      mant = mant << 1 | 1;
+      exp--;
+    }
+    mant -= 8;
+  }
+
+  *exp_out  = exp;
+  *mant_out = mant;
+}
+
+/* 4.2.16 */
+static void ref_APCM_inverse_quantization(word *xMc, word mant, word exp,
+                                          word *xMp)
+{
+  int	i;
+  word	temp, temp1, temp2, temp3;
+  longword	ltmp;
+
+  temp1 = gsm_FAC[ mant ];	/* see 4.2-15 for mant */
+  temp2 = GSM_SUB( 6, exp );	/* see 4.2-15 for exp  */
+  temp3 = ref_asl( 1, GSM_SUB( temp2, 1 ));
+
+  for (i = 13; i--;) {
+    temp = (*xMc++ << 1) - 7;	        /* restore sign   */
+    temp <<= 12;				/* 16 bit signed  */
+    temp = GSM_MULT_R( temp1, temp );
+    temp = GSM_ADD( temp, temp3 );
+    *xMp++ = temp >> temp2;
+  }
+}
+
+/* 4.2.17 */
+static void ref_RPE_grid_positioning(word Mc, word *xMp, word *ep)
+{
+  int	i;
+
+  switch (Mc) {
+  case 3: *ep++ = 0;
+  case 2: *ep++ = 0;
+  case 1: *ep++ = 0;
+  case 0: *ep++ = *xMp++;
+  }
+  i = 12;
+  do {
+    *ep++ = 0;
+    *ep++ = 0;
+    *ep++ = *xMp++;
+  } while (--i);
+
+  while (++Mc < 4) *ep++ = 0;
+}
+
+/* 4.2.18 */
+static void ref_Gsm_RPE_Decoding(word xmaxcr, word Mcr, word *xMcr,
+                                 word *erp)
+{
+  word	exp, mant;
+  word	xMp[ 13 ];
+
+  ref_APCM_quantization_xmaxc_to_exp_mant( xmaxcr, &exp, &mant );
+  ref_APCM_inverse_quantization( xMcr, mant, exp, xMp );
+  ref_RPE_grid_positioning( Mcr, xMp, erp );
+}
+
+
+/* reference: 4.3 Postprocessing, then the player's upsampler *****/
+
+static void ref_Postprocessing(struct gsm_state *S, word *s)
+{
+  register int		k;
+  register word		msr = S->msr;
+  register longword	ltmp;	/* for GSM_ADD */
+  register word		tmp;
+
+  for (k = 160; k--; s++) {
+    tmp = GSM_MULT_R( msr, 28180 );
+    msr = GSM_ADD(*s, tmp);  	   /* Deemphasis 	     */
+    *s  = GSM_ADD(msr, msr) & 0xFFF8;  /* Truncation & Upscaling */
+  }
+  S->msr = msr;
+}
+
+/* what streaming_run() did with gsm_decode()'s output */
+static void ref_upsample(const word *s, int *last_sample, signed char *dst)
+{
+  unsigned int i;
+
+  for(i = 0; i < 160; i++)
+  {
+    int cur_sample = s[i];
+
+    /* 2:1 linear interpolation */
+    *dst++ = (*last_sample + cur_sample) >> 9;
+    *dst++ = cur_sample >> 8;
+    *last_sample = cur_sample;
+  }
+}
+
+
+/* reference: the byte-at-a-time unpacker in gsm_decode() *********/
+
+static void ref_Unpack_frame(const gsm_byte *c, struct gsm_params *p)
+{
+  word  	LARc[8], Nc[4], Mc[4], bc[4], xmaxc[4], xmc[13*4];
+  int		i, j;
+
+  LARc[0]  = (*c++ & 0xF) << 2;		/* 1 */
+  LARc[0] |= (*c >> 6) & 0x3;
+  LARc[1]  = *c++ & 0x3F;
+  LARc[2]  = (*c >> 3) & 0x1F;
+  LARc[3]  = (*c++ & 0x7) << 2;
+  LARc[3] |= (*c >> 6) & 0x3;
+  LARc[4]  = (*c >> 2) & 0xF;
+  LARc[5]  = (*c++ & 0x3) << 2;
+  LARc[5] |= (*c >> 6) & 0x3;
+  LARc[6]  = (*c >> 3) & 0x7;
+  LARc[7]  = *c++ & 0x7;
+  Nc[0]  = (*c >> 1) & 0x7F;
+  bc[0]  = (*c++ & 0x1) << 1;
+  bc[0] |= (*c >> 7) & 0x1;
+  Mc[0]  = (*c >> 5) & 0x3;
+  xmaxc[0]  = (*c++ & 0x1F) << 1;
+  xmaxc[0] |= (*c >> 7) & 0x1;
+  xmc[0]  = (*c >> 4) & 0x7;
+  xmc[1]  = (*c >> 1) & 0x7;
+  xmc[2]  = (*c++ & 0x1) << 2;
+  xmc[2] |= (*c >> 6) & 0x3;
+  xmc[3]  = (*c >> 3) & 0x7;
+  xmc[4]  = *c++ & 0x7;
+  xmc[5]  = (*c >> 5) & 0x7;
+  xmc[6]  = (*c >> 2) & 0x7;
+  xmc[7]  = (*c++ & 0x3) << 1;		/* 10 */
+  xmc[7] |= (*c >> 7) & 0x1;
+  xmc[8]  = (*c >> 4) & 0x7;
+  xmc[9]  = (*c >> 1) & 0x7;
+  xmc[10]  = (*c++ & 0x1) << 2;
+  xmc[10] |= (*c >> 6) & 0x3;
+  xmc[11]  = (*c >> 3) & 0x7;
+  xmc[12]  = *c++ & 0x7;
+  Nc[1]  = (*c >> 1) & 0x7F;
+  bc[1]  = (*c++ & 0x1) << 1;
+  bc[1] |= (*c >> 7) & 0x1;
+  Mc[1]  = (*c >> 5) & 0x3;
+  xmaxc[1]  = (*c++ & 0x1F) << 1;
+  xmaxc[1] |= (*c >> 7) & 0x1;
+  xmc[13]  = (*c >> 4) & 0x7;
+  xmc[14]  = (*c >> 1) & 0x7;
+  xmc[15]  = (*c++ & 0x1) << 2;
+  xmc[15] |= (*c >> 6) & 0x3;
+  xmc[16]  = (*c >> 3) & 0x7;
+  xmc[17]  = *c++ & 0x7;
+  xmc[18]  = (*c >> 5) & 0x7;
+  xmc[19]  = (*c >> 2) & 0x7;
+  xmc[20]  = (*c++ & 0x3) << 1;
+  xmc[20] |= (*c >> 7) & 0x1;
+  xmc[21]  = (*c >> 4) & 0x7;
+  xmc[22]  = (*c >> 1) & 0x7;
+  xmc[23]  = (*c++ & 0x1) << 2;
+  xmc[23] |= (*c >> 6) & 0x3;
+  xmc[24]  = (*c >> 3) & 0x7;
+  xmc[25]  = *c++ & 0x7;
+  Nc[2]  = (*c >> 1) & 0x7F;
+  bc[2]  = (*c++ & 0x1) << 1;		/* 20 */
+  bc[2] |= (*c >> 7) & 0x1;
+  Mc[2]  = (*c >> 5) & 0x3;
+  xmaxc[2]  = (*c++ & 0x1F) << 1;
+  xmaxc[2] |= (*c >> 7) & 0x1;
+  xmc[26]  = (*c >> 4) & 0x7;
+  xmc[27]  = (*c >> 1) & 0x7;
+  xmc[28]  = (*c++ & 0x1) << 2;
+  xmc[28] |= (*c >> 6) & 0x3;
+  xmc[29]  = (*c >> 3) & 0x7;
+  xmc[30]  = *c++ & 0x7;
+  xmc[31]  = (*c >> 5) & 0x7;
+  xmc[32]  = (*c >> 2) & 0x7;
+  xmc[33]  = (*c++ & 0x3) << 1;
+  xmc[33] |= (*c >> 7) & 0x1;
+  xmc[34]  = (*c >> 4) & 0x7;
+  xmc[35]  = (*c >> 1) & 0x7;
+  xmc[36]  = (*c++ & 0x1) << 2;
+  xmc[36] |= (*c >> 6) & 0x3;
+  xmc[37]  = (*c >> 3) & 0x7;
+  xmc[38]  = *c++ & 0x7;
+  Nc[3]  = (*c >> 1) & 0x7F;
+  bc[3]  = (*c++ & 0x1) << 1;
+  bc[3] |= (*c >> 7) & 0x1;
+  Mc[3]  = (*c >> 5) & 0x3;
+  xmaxc[3]  = (*c++ & 0x1F) << 1;
+  xmaxc[3] |= (*c >> 7) & 0x1;
+  xmc[39]  = (*c >> 4) & 0x7;
+  xmc[40]  = (*c >> 1) & 0x7;
+  xmc[41]  = (*c++ & 0x1) << 2;
+  xmc[41] |= (*c >> 6) & 0x3;
+  xmc[42]  = (*c >> 3) & 0x7;
+  xmc[43]  = *c++ & 0x7;			/* 30  */
+  xmc[44]  = (*c >> 5) & 0x7;
+  xmc[45]  = (*c >> 2) & 0x7;
+  xmc[46]  = (*c++ & 0x3) << 1;
+  xmc[46] |= (*c >> 7) & 0x1;
+  xmc[47]  = (*c >> 4) & 0x7;
+  xmc[48]  = (*c >> 1) & 0x7;
+  xmc[49]  = (*c++ & 0x1) << 2;
+  xmc[49] |= (*c >> 6) & 0x3;
+  xmc[50]  = (*c >> 3) & 0x7;
+  xmc[51]  = *c & 0x7;			/* 33 */
+
+  for (i = 0; i < 8; i++) p->LARc[i] = LARc[i];
+  for (j = 0; j < 4; j++) {
+    p->sub[j].Nc = Nc[j];
+    p->sub[j].bc = bc[j];
+    p->sub[j].Mc = Mc[j];
+    p->sub[j].xmaxc = xmaxc[j];
+    for (i = 0; i < 13; i++) p->sub[j].xmc[i] = xmc[13 * j + i];
+  }
+}
+
+
+/* test input *******************************************************/
+
+static unsigned long test_rnd = 2463534242UL;
+
+static unsigned int test_rand(void)
+{
+  test_rnd ^= (test_rnd << 13) & 0xFFFFFFFFUL;
+  test_rnd ^= test_rnd >> 17;
+  test_rnd ^= (test_rnd << 5) & 0xFFFFFFFFUL;
+  return test_rnd & 0xFFFF;
+}
+
+/* Reads the next frame from fp, or makes up a random one with a
+   good magic number if fp is NULL.  Returns 0 at the end. */
+static int next_frame(FILE *fp, unsigned long *n_left, gsm_frame frame)
+{
+  unsigned int i;
+
+  if(fp)
+    return fread(frame, sizeof(gsm_frame), 1, fp) == 1;
+  if(*n_left == 0)
+    return 0;
+  --*n_left;
+  for(i = 0; i < sizeof(gsm_frame); i++)
+    frame[i] = test_rand();
+  frame[0] = (frame[0] & 0x0F) | GSM_MAGIC << 4;
+  return 1;
+}
+
+static FILE *open_input(const char *name, int argc, char **argv)
+{
+  FILE *fp;
+
+  if(argc < 1)
+    return NULL;
+  fp = fopen(argv[0], "rb");
+  if(!fp)
+  {
+    fprintf(stderr, "%s: could not open input file ", name);
+    perror(argv[0]);
+    exit(1);
+  }
+  return fp;
+}
+
+
+/* tests ************************************************************/
+
+static const unsigned char lar_bits[8] = { 6, 6, 5, 5, 4, 4, 3, 3 };
+
+/* Every LARc[i] code goes through both the table lookups and the
+   arithmetic they replaced.  64 frames cover all of them, since
+   LARc[i] = code & (2^bits - 1) visits each narrower code too. */
+static int test_lar(int argc, char **argv)
+{
+  unsigned int code, i;
+
+  for(code = 0; code < 64; code++)
+  {
+    word LARc[8], LARpp[8], rp[8];
+    word ref_LARpp[8], ref_rp[8];
+
+    for(i = 0; i < 8; i++)
+      LARc[i] = code & ((1U << lar_bits[i]) - 1);
+
+    Decoding_of_the_coded_Log_Area_Ratios(LARc, LARpp);
+    LARc_to_rp(LARc, rp);
+    ref_Decoding_of_the_coded_Log_Area_Ratios(LARc, ref_LARpp);
+    ref_Coefficients_40_159(ref_LARpp, ref_rp);
+    ref_LARp_to_rp(ref_rp);
+
+    for(i = 0; i < 8; i++)
+    {
+      if(LARpp[i] != ref_LARpp[i] || rp[i] != ref_rp[i])
+      {
+        fprintf(stderr,
+                "lar: LARc[%u] = %d: LARpp %d, rp %d; should be %d, %d\n",
+                i, LARc[i], LARpp[i], rp[i], ref_LARpp[i], ref_rp[i]);
+        return 1;
+      }
+    }
+  }
+  printf("lar: all %u LARc codes match\n", (unsigned int)GSM_LARC_TAB_LEN);
+  return 0;
+}
+/* LARpp(j-1) and LARpp(j) come from the previous and this frame's
+   LARc, or LARpp(j-1) is the initial 0, so that covers every input
+   the interpolation and LARp_to_rp() can get. */
+static int test_coef(int argc, char **argv)
+{
+  typedef void (*COEF_FN)(word *, word *, word *);
+  static const COEF_FN coef[3] =
+  {
+    Coefficients_0_12, Coefficients_13_26, Coefficients_27_39
+  };
+  static const COEF_FN ref_coef[3] =
+  {
+    ref_Coefficients_0_12, ref_Coefficients_13_26, ref_Coefficients_27_39
+  };
+  unsigned int prev, code, i, k;
+  unsigned long n_pairs = 0;
+
+  for(prev = 0; prev <= 64; prev++)
+    for(code = 0; code < 64; code++)
+    {
+      word LARpp_j_1[8], LARpp_j[8];
+
+      for(i = 0; i < 8; i++)
+      {
+        unsigned int mask = (1U << lar_bits[i]) - 1;
+
+        /* prev = 64 stands for the initial LARpp(j-1) = 0 */
+        LARpp_j_1[i] = prev < 64
+                       ? gsm_LARpp_tab[gsm_LARc_base[i] + (prev & mask)]
+                       : 0;
+        LARpp_j[i] = gsm_LARpp_tab[gsm_LARc_base[i] + (code & mask)];
+      }
+
+      for(k = 0; k < 3; k++)
+      {
+        word LARp[8], ref_LARp[8];
+
+        coef[k](LARpp_j_1, LARpp_j, LARp);
+        LARp_to_rp(LARp);
+        ref_coef[k](LARpp_j_1, LARpp_j, ref_LARp);
+        ref_LARp_to_rp(ref_LARp);
+        for(i = 0; i < 8; i++)
+        {
+          if(LARp[i] != ref_LARp[i])
+          {
+            fprintf(stderr,
+                    "coef: step %u, LARpp[%u] %d then %d: rp %d; "
+                    "should be %d\n",
+                    k, i, LARpp_j_1[i], LARpp_j[i], LARp[i], ref_LARp[i]);
+            return 1;
+          }
+        }
+      }
+      n_pairs++;
+    }
+  printf("coef: all %lu LARc pairs match\n", n_pairs);
+  return 0;
+}
+
+/* Every xmaxc with every grid position.  Rotating the 8 xMc codes
+   through the 13 pulses puts each code in each pulse position. */
+static int test_apcm(int argc, char **argv)
+{
+  struct gsm_state S;
+  unsigned int xmaxc, Mc, rot, i;
+
+  memset(&S, 0, sizeof(S));
+  for(xmaxc = 0; xmaxc < 64; xmaxc++)
+    for(Mc = 0; Mc < 4; Mc++)
+      for(rot = 0; rot < 8; rot++)
+      {
+        word xMc[13], erp[40], ref_erp[40];
+
+        for(i = 0; i < 13; i++)
+          xMc[i] = (i + rot) & 7;
+        Gsm_RPE_Decoding(&S, xmaxc, Mc, xMc, erp);
+        ref_Gsm_RPE_Decoding(xmaxc, Mc, xMc, ref_erp);
+
+        for(i = 0; i < 40; i++)
+        {
+          if(erp[i] != ref_erp[i])
+          {
+            fprintf(stderr,
+                    "apcm: xmaxc %u, Mc %u, erp[%u] = %d; should be %d\n",
+                    xmaxc, Mc, i, erp[i], ref_erp[i]);
+            return 1;
+          }
+        }
+      }
+  printf("apcm: all 64 * 8 xMp values match at all 4 grid positions\n");
+  return 0;
+}
+
+/* Two decoders run side by side.  The new path finishes each frame
+   in two pieces whose split moves every frame, as the player does
+   when a frame straddles two DMA segments. */
+static int test_post(int argc, char **argv)
+{
+  FILE *fp = open_input("post", argc, argv);
+  unsigned long n_left = 2000, n_frames = 0;
+  struct gsm_state old_dec, new_dec;
+  gsm_frame frame;
+  int last_sample = 0;
+
+#if GSM_UPSAMPLE_TAPS != 2 || GSM_DITHER || defined(GSM_FAST)
+  fputs("post: this build changes the output on purpose, "
+        "so expect a mismatch\n", stderr);
+#endif
+  memset(&old_dec, 0, sizeof(old_dec));
+  old_dec.nrp = 40;
+  new_dec = old_dec;
+
+  while(next_frame(fp, &n_left, frame))
+  {
+    word old_s[160], new_s[160];
+    signed char old_out[320], new_out[320];
+    unsigned int i, split = n_frames * 37 % 161;
+
+    gsm_decode_raw(&old_dec, frame, old_s);
+    ref_Postprocessing(&old_dec, old_s);
+    ref_upsample(old_s, &last_sample, old_out);
+
+    gsm_decode_raw(&new_dec, frame, new_s);
+    gsm_postprocess_s8(&new_dec, new_s, split, new_out);
+    gsm_postprocess_s8(&new_dec, new_s + split, 160 - split,
+                       new_out + 2 * split);
+
+    for(i = 0; i < 320; i++)
+    {
+      if(old_out[i] != new_out[i])
+      {
+        fprintf(stderr, "post: frame %lu, byte %u is %d; should be %d\n",
+                n_frames, i, new_out[i], old_out[i]);
+        if(fp)
+          fclose(fp);
+        return 1;
+      }
+    }
+    n_frames++;
+  }
+  if(fp)
+    fclose(fp);
+  printf("post: %lu frames match byte for byte\n", n_frames);
+  return 0;
+}
+
+static int unpack_one(const gsm_frame frame, const char *what,
+                      unsigned long n)
+{
+  struct gsm_params p, ref_p;
+
+  memset(&p, 0x55, sizeof(p));
+  memset(&ref_p, 0x55, sizeof(ref_p));
+  Unpack_frame(frame, &p);
+  ref_Unpack_frame(frame, &ref_p);
+  if(memcmp(&p, &ref_p, sizeof(p)))
+  {
+    unsigned int i;
+
+    fprintf(stderr, "unpack: %s %lu differs:", what, n);
+    for(i = 0; i < sizeof(gsm_frame); i++)
+      fprintf(stderr, " %02x", frame[i]);
+    fputc('\n', stderr);
+    return 1;
+  }
+  return 0;
+}
+
+/* A frame with one bit set catches a field read from the wrong
+   place; random frames catch fields that bleed into each other. */
+static int test_unpack(int argc, char **argv)
+{
+  unsigned long n_random = argc >= 1 ? strtoul(argv[0], NULL, 10) : 20000;
+  unsigned long n_left = n_random, n;
+  gsm_frame frame;
+
+  for(n = 0; n < 8 * sizeof(gsm_frame); n++)
+  {
+    memset(frame, 0, sizeof(frame));
+    frame[n / 8] = 0x80 >> (n % 8);
+    if(unpack_one(frame, "bit", n))
+      return 1;
+  }
+  memset(frame, 0xFF, sizeof(frame));
+  if(unpack_one(frame, "all ones", 0))
+    return 1;
+  for(n = 0; next_frame(NULL, &n_left, frame); n++)
+    if(unpack_one(frame, "random frame", n))
+      return 1;
+  printf("unpack: %u single-bit frames and %lu random frames match\n",
+         (unsigned int)(8 * sizeof(gsm_frame)), n_random);
+  return 0;
+}
+
+
+static const struct
+{
+  const char *name;
+  int (*run)(int argc, char **argv);
+} tests[] =
+{
+  { "lar", test_lar },
+  { "coef", test_coef },
+  { "apcm", test_apcm },
+  { "post", test_post },
+  { "unpack", test_unpack },
+};
+
+int main(int argc, char **argv)
+{
+  unsigned int i;
+
+  if(argc >= 2)
+  {
+    for(i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+      if(!strcmp(argv[1], tests[i].name))
+        return tests[i].run(argc - 2, argv + 2);
+  }
+  fputs(help_text, stderr);
+  return 1;
+}
@@ -0,0 +1,130 @@
+/* lartab.c
+   generate the log area ratio decoding tables for gsmcode.c
+
+Copyright 2026 GBAWAVE contributors.
+Based on GSM RPE-LTP 1.0.10, Copyright 1992-1994 by Jutta Degener
+and Carsten Bormann, Technische Universitaet Berlin.
+See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+
+*/
+
+/* Each LARc[i] is only 6, 6, 5, 5, 4, 4, 3, or 3 bits wide, so every
+   value that Decoding_of_the_coded_Log_Area_Ratios() can produce fits
+   in a table of 240 words.  The same goes for the reflection
+   coefficients of samples 40..159, where LARp is just LARpp.  This
+   program runs the arithmetic from the spec for every code value and
+   writes both tables as a C header:
+
+     lartab lartab.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../private.h"
+
+static const word lar_B[8]    = {    0,     0,  2048, -2560,    94, -1792,  -341, -1144 };
+static const word lar_MIC[8]  = {  -32,   -32,   -16,   -16,    -8,    -8,    -4,    -4 };
+static const word lar_INVA[8] = { 13107, 13107, 13107, 13107, 19223, 17476, 31454, 29708 };
+static const unsigned char lar_bits[8] = { 6, 6, 5, 5, 4, 4, 3, 3 };
+
+static const char help_text[] =
+"Generates the LARc decoding tables for gsmcode.c.\n"
+"usage: lartab OUTFILE\n";
+
+
+/* 4.2.8, one coefficient */
+static word decode_LARc(unsigned int i, word LARc)
+{
+  word temp1;
+  longword ltmp;
+
+  temp1 = GSM_ADD( LARc, lar_MIC[i] ) << 10;
+  temp1 = GSM_SUB( temp1, lar_B[i] << 1 );
+  temp1 = GSM_MULT_R( lar_INVA[i], temp1 );
+  return GSM_ADD( temp1, temp1 );
+}
+
+
+/* 4.2.9.2, one coefficient */
+static word LARp_to_rp(word LARp)
+{
+  word temp;
+  longword ltmp;
+
+  if (LARp < 0) {
+    temp = LARp == MIN_WORD ? MAX_WORD : -LARp;
+    return - ((temp < 11059) ? temp << 1
+              : ((temp < 20070) ? temp + 11059
+                 :  GSM_ADD( temp >> 2, 26112 )));
+  } else {
+    temp = LARp;
+    return (temp < 11059) ? temp << 1
+      : ((temp < 20070) ? temp + 11059
+         :  GSM_ADD( temp >> 2, 26112 ));
+  }
+}
+
+
+static void write_table(FILE *fp, const char *name, int want_rp)
+{
+  unsigned int i, c;
+
+  fprintf(fp, "static const word %s[GSM_LARC_TAB_LEN] =\n{", name);
+  for(i = 0; i < 8; i++)
+  {
+    fprintf(fp, "\n  /* LARc[%u] */", i);
+    for(c = 0; c < 1U << lar_bits[i]; c++)
+    {
+      word LARpp = decode_LARc(i, c);
+
+      if(c % 8 == 0)
+        fputs("\n ", fp);
+      fprintf(fp, " %6d,", want_rp ? LARp_to_rp(LARpp) : LARpp);
+    }
+  }
+  fputs("\n};\n\n", fp);
+}
+
+
+int main(int argc, char **argv)
+{
+  FILE *fp;
+  unsigned int i, offset = 0;
+
+  if(argc != 2)
+  {
+    fputs(help_text, stderr);
+    return 1;
+  }
+
+  fp = fopen(argv[1], "w");
+  if(!fp)
+  {
+    fputs("lartab could not open output file ", stderr);
+    perror(argv[1]);
+    return 1;
+  }
+
+  fputs("/* generated by tools/lartab.c; do not edit */\n\n", fp);
+
+  /* where each coefficient's codes start in the tables */
+  fputs("static const unsigned char gsm_LARc_base[8] =\n{\n ", fp);
+  for(i = 0; i < 8; i++)
+  {
+    fprintf(fp, " %u,", offset);
+    offset += 1U << lar_bits[i];
+  }
+  fputs("\n};\n\n", fp);
+  fprintf(fp, "#define GSM_LARC_TAB_LEN %u\n\n", offset);
+
+  /* LARc -> LARpp, 4.2.8 */
+  write_table(fp, "gsm_LARpp_tab", 0);
+
+  /* LARc -> rp for samples 40..159, 4.2.8 then 4.2.9.2 */
+  write_table(fp, "gsm_rp_tab", 1);
+
+  fclose(fp);
+  return 0;
+}
@@ -0,0 +1,117 @@
+/* pcmsnr.c
+   compare two raw PCM files
+
+Copyright 2026 GBAWAVE contributors.
+See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+
+*/
+
+/* Reports how far TEST is from REF, both signed 16-bit little-endian
+   mono, as signal-to-noise ratio and peak error.  The 8-bit figures
+   are what the GBA's DirectSound FIFO actually gets (sample >> 8).
+   Several pairs can be given to measure a whole corpus at once.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+static const char help_text[] =
+"Compares signed 16-bit little-endian PCM files.\n"
+"usage: pcmsnr REF TEST [REF TEST...]\n";
+
+/* Reads one sample into *out.  Returns 0 at the end of the file;
+   a sample of -1 can't be told from EOF through the return value. */
+static int fgeti16(FILE *fp, int *out)
+{
+  int lo = fgetc(fp);
+  int hi = fgetc(fp);
+
+  if(hi == EOF)
+    return 0;
+  *out = (signed short)(lo | hi << 8);
+  return 1;
+}
+
+struct PCM_STATS
+{
+  unsigned long n;
+  double signal, noise;
+  int max_err;
+  unsigned long n_diff8;
+  int max_err8;
+};
+
+static void report(const char *name, const struct PCM_STATS *st)
+{
+  printf("%s: %lu samples, ", name, st->n);
+  if(st->noise > 0)
+    printf("SNR %.2f dB, ", 10 * log10(st->signal / st->noise));
+  else
+    fputs("identical, ", stdout);
+  printf("max error %d; 8-bit: %lu samples differ, max error %d\n",
+         st->max_err, st->n_diff8, st->max_err8);
+}
+
+int main(int argc, char **argv)
+{
+  struct PCM_STATS total = {0};
+  int arg;
+
+  if(argc < 3 || argc % 2 != 1)
+  {
+    fputs(help_text, stderr);
+    return 1;
+  }
+
+  for(arg = 1; arg < argc; arg += 2)
+  {
+    struct PCM_STATS st = {0};
+    FILE *ref = fopen(argv[arg], "rb");
+    FILE *test = fopen(argv[arg + 1], "rb");
+
+    if(!ref || !test)
+    {
+      fputs("pcmsnr could not open ", stderr);
+      perror(ref ? argv[arg + 1] : argv[arg]);
+      return 1;
+    }
+
+    for(;;)
+    {
+      int r, t;
+      int err, err8;
+
+      if(!fgeti16(ref, &r) || !fgeti16(test, &t))
+        break;
+      err = abs(t - r);
+      err8 = abs((t >> 8) - (r >> 8));
+      st.n++;
+      st.signal += (double)r * r;
+      st.noise += (double)err * err;
+      if(err > st.max_err)
+        st.max_err = err;
+      if(err8)
+        st.n_diff8++;
+      if(err8 > st.max_err8)
+        st.max_err8 = err8;
+    }
+    fclose(ref);
+    fclose(test);
+    report(argv[arg + 1], &st);
+
+    total.n += st.n;
+    total.signal += st.signal;
+    total.noise += st.noise;
+    total.n_diff8 += st.n_diff8;
+    if(st.max_err > total.max_err)
+      total.max_err = st.max_err;
+    if(st.max_err8 > total.max_err8)
+      total.max_err8 = st.max_err8;
+  }
+
+  if(argc > 3)
+    report("total", &total);
+  return 0;
+}
@@ -0,0 +1,193 @@
+/* savdump.c
+   print what the GSM player left in battery SRAM
+
+Copyright 2026 GBAWAVE contributors.
+See the accompanying file "TOAST-COPYRIGHT.txt" for details.
+THERE IS ABSOLUTELY NO WARRANTY FOR THIS SOFTWARE.
+
+*/
+
+/* Reads a .sav file that an emulator (or gsmsim -s) saved from the
+   player and prints the telemetry record, described in telemetry.h,
+   and, from a player built with PROFILE = 1, the profile windows,
+   described in profile.h, oldest first.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned int u32;
+
+#include "../profile.h"
+#include "../telemetry.h"
+
+static const char help_text[] =
+"Prints what the GSM player left in battery SRAM.\n"
+"usage: savdump SAVFILE\n";
+
+static const char *const stage_names[PROF_N_STAGES] =
+{
+  "unpack", "rpe", "ltp", "stsf", "post", "seg", "hud"
+};
+
+static unsigned char sav[0x10000];
+static size_t sav_len;
+
+static unsigned long get32(size_t off)
+{
+  return sav[off] | (unsigned long)sav[off + 1] << 8
+         | (unsigned long)sav[off + 2] << 16
+         | (unsigned long)sav[off + 3] << 24;
+}
+
+/* load_tele() **************
+   Reads the telemetry slot at off into r.  Returns 0 if it isn't a
+   whole record.
+*/
+static int load_tele(size_t off, struct TELE_RECORD *r)
+{
+  u32 *w = &r->seq;
+  u32 sum = 0;
+
+  if(sav_len < off + sizeof(*r) || memcmp(sav + off, TELE_SRAM_MAGIC, 8))
+    return 0;
+  memcpy(r->magic, sav + off, 8);
+  for(off += 8; w <= &r->check; w++, off += 4)
+    *w = get32(off);
+  for(w = &r->seq; w < &r->check; w++)
+    sum += *w;
+  return sum == r->check;
+}
+
+/* dump_tele() **************
+   Prints the newer good telemetry slot.  Returns 0 if there is none.
+*/
+static int dump_tele(void)
+{
+  struct TELE_RECORD slots[2], *r = NULL;
+  unsigned int i;
+  double secs;
+
+  for(i = 0; i < 2; i++)
+    if(load_tele(TELE_SRAM_OFF + i * TELE_SLOT_LEN, slots + i)
+       && (!r || slots[i].seq > r->seq))
+      r = slots + i;
+  if(!r)
+    return 0;
+
+  /* a segment is a video frame */
+  secs = r->segments * 280896.0 / 16777216;
+  printf("telemetry: save %u, %u boots, %u segments (%.0f:%02.0f played)\n",
+         r->seq, r->boots, r->segments,
+         (double)(int)(secs / 60), secs - 60 * (int)(secs / 60));
+  printf("missed swaps: %u\n", r->lead_hist[0]);
+  printf("segments decoded ahead when one started:");
+  for(i = 0; i < TELE_LEADS; i++)
+    printf(" %u%s:%u", i, i == TELE_LEADS - 1 ? "+" : "", r->lead_hist[i]);
+  printf("\ncycles to decode a segment, worst %u (%.2f frames):\n",
+         r->worst_fill, r->worst_fill / 280896.0);
+  for(i = 0; i < TELE_FILL_BINS; i++)
+  {
+    if(i == TELE_FILL_BINS - 1)
+      printf("  %u/8 frame or more: %u\n", i, r->fill_hist[i]);
+    else
+      printf("  %u/8 to %u/8 frame: %u\n", i, i + 1, r->fill_hist[i]);
+  }
+  printf("worst main loop: %u cycles (%.2f frames)\n",
+         r->worst_main, r->worst_main / 280896.0);
+  printf("track changes: %u\n", r->changes);
+  if(r->changes)
+  {
+    printf("  missed swaps during them: %u\n", r->change_underruns);
+    printf("  longest: %u frames\n", r->worst_change_frames);
+    printf("  worst main loop during one: %u cycles\n",
+           r->worst_change_main);
+    printf("  fewest segments queued during one: %u\n",
+           r->change_min_lead);
+  }
+  printf("last boot: GBFS found after %u cycles, audio after %u cycles"
+         " (%.2f frames)\n", r->boot_gbfs_cycles, r->boot_audio_cycles,
+         r->boot_audio_cycles / 280896.0);
+  return 1;
+}
+
+/* dump_profile() **************
+   Prints the ring of profile windows.  Returns 0 if there is none.
+*/
+static int dump_profile(void)
+{
+  size_t base = PROF_SRAM_OFF;
+  size_t rec_len = PROF_N_STAGES * 16;
+  unsigned long windows, first, w;
+  unsigned int n_stages, ring, window;
+
+  if(sav_len < base + 16 || memcmp(sav + base, PROF_SRAM_MAGIC, 8))
+    return 0;
+  windows = get32(base + 8);
+  n_stages = sav[base + 12];
+  ring = sav[base + 13];
+  window = sav[base + 14] | sav[base + 15] << 8;
+  if(n_stages != PROF_N_STAGES || ring == 0
+     || sav_len < base + 16 + ring * rec_len)
+  {
+    fputs("savdump: profile is from a different build\n", stderr);
+    return 0;
+  }
+
+  printf("profile: %lu windows of %u video frames, last %u kept\n",
+         windows, window, ring);
+  first = windows > ring ? windows - ring : 0;
+  for(w = first; w < windows; w++)
+  {
+    size_t rec = base + 16 + (w % ring) * rec_len;
+    unsigned int i;
+
+    printf("\nwindow %lu\n", w);
+    printf("stage       count      min     mean      max\n");
+    for(i = 0; i < PROF_N_STAGES; i++)
+    {
+      size_t st = rec + i * 16;
+      unsigned long count = get32(st + 12);
+
+      if(count == 0)
+      {
+        printf("%-8s %8lu\n", stage_names[i], count);
+        continue;
+      }
+      printf("%-8s %8lu %8lu %8lu %8lu\n", stage_names[i], count,
+             get32(st), get32(st + 8) / count, get32(st + 4));
+    }
+  }
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  FILE *fp;
+  int i;
+
+  if(argc != 2)
+  {
+    fputs(help_text, stderr);
+    return 1;
+  }
+  fp = fopen(argv[1], "rb");
+  if(!fp)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  sav_len = fread(sav, 1, sizeof(sav), fp);
+  fclose(fp);
+
+  i = dump_tele();
+  if(i)
+    putchar('\n');
+  if(!dump_profile() && !i)
+  {
+    fputs("savdump: nothing from the player in this file\n", stderr);
+    return 1;
+  }
+  return 0;
+}